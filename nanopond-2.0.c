@@ -3,14 +3,16 @@
 /**
  * Output a line of comma-seperated statistics data
  *
+ * @param pond Pond to report on
  * @param clock Current clock
  */
 #ifdef REPORT_FREQUENCY
-static void doReport(const uint64_t clock)
+static void doReport(struct Pond *const pond, const uint64_t clock)
 {
   static uint64_t lastTotalViableReplicators = 0;
 
-  uint64_t i;
+  struct PerReportStatCounters statCounters;
+  uint64_t i, x;
 
   uint64_t totalActiveCells = 0;
   uint64_t totalEnergy = 0;
@@ -18,7 +20,7 @@ static void doReport(const uint64_t clock)
   uint64_t maxGeneration = 0;
 
   for(i=0;i<POND_SIZE;++i) {
-    struct Cell *const c = &pond[i];
+    struct Cell *const c = &pond->cells[i];
     if (c->energy) {
       ++totalActiveCells;
       totalEnergy += (uint64_t)c->energy;
@@ -31,6 +33,24 @@ static void doReport(const uint64_t clock)
     }
   }
 
+  /* Add up the counts of all VM contexts */
+  memset(&statCounters, 0, sizeof(statCounters));
+  for(i=0;i<VM_CONTEXTS;++i) {
+    struct PerReportStatCounters *const s = &pond->vm[i].stats;
+    for(x=0;x<16;++x) {
+      statCounters.instructionExecutions[x] += s->instructionExecutions[x];
+    }
+    statCounters.cellExecutions += s->cellExecutions;
+    statCounters.viableCellsReplaced += s->viableCellsReplaced;
+    statCounters.viableCellsKilled += s->viableCellsKilled;
+    statCounters.viableCellShares += s->viableCellShares;
+#ifdef TRACE_CACHE
+    statCounters.traceLookups += s->traceLookups;
+    statCounters.traceHits += s->traceHits;
+#endif
+    memset(s, 0, sizeof(struct PerReportStatCounters));
+  }
+
   /* Look here to get the columns in the CSV output */
 
   /* The first five are here and are self-explanatory */
@@ -74,44 +94,13 @@ static void doReport(const uint64_t clock)
 
   lastTotalViableReplicators = totalViableReplicators;
 
-  /* Reset per-report stat counters */
-  for(x=0;x<sizeof(statCounters);++x){
-    ((uint8_t *)&statCounters)[x] = (uint8_t)0;
-  }
+#ifdef TRACE_CACHE
+  fprintf(stderr,"[TRACE] %" PRIu64 " of %" PRIu64 " executions replayed a trace (%.1f%%)\n", statCounters.traceHits, statCounters.traceLookups, (statCounters.traceLookups > 0) ? (100.0 * (double)statCounters.traceHits / (double)statCounters.traceLookups) : 0.0);
+#endif
 }
 #endif //REPORT_FREQUENCY
 
-/**
- * Dumps all viable (generation > 2) cells to a file called <clock>.dump
- *
- * @param clock Clock value
- */
-#ifdef DUMP_FREQUENCY
-static void doDump(const uint64_t clock)
-{
-  char buf[POND_DEPTH*2];
-  FILE *d;
-  uint64_t i,wordPtr,shiftPtr,stopCount,i;
-  struct Cell *cell;
-  genome_t inst;
-
-  sprintf(buf,"%" PRIu64 ".dump.csv",clock);
-  d = fopen(buf,"w");
-  if (!d) {
-    fprintf(stderr,"[WARNING] Could not open %s for writing.\n",buf);
-    return;
-  }
-
-  fprintf(stderr,"[INFO] Dumping viable cells to %s\n",buf);
-
-  for(i=0;i<POND_SIZE;++i) {
-    cell = &pond[i];
-    dumpCell(d, cell);
-  }
-  fclose(d);
-}
-#endif //DUMP_FREQUENCY
-
+#if defined(DUMP_FREQUENCY) || defined(USE_SDL)
 /**
  * Dumps the genome of a cell to a file.
  *
@@ -155,6 +144,38 @@ static void dumpCell(FILE *file, struct Cell *cell)
   }
   fwrite("\n",1,1,file);
 }
+#endif /* DUMP_FREQUENCY || USE_SDL */
+
+/**
+ * Dumps all viable (generation > 2) cells to a file called <clock>.dump
+ *
+ * @param pond Pond to dump
+ * @param clock Clock value
+ */
+#ifdef DUMP_FREQUENCY
+static void doDump(struct Pond *const pond, const uint64_t clock)
+{
+  char buf[POND_DEPTH*2];
+  FILE *d;
+  uint64_t i;
+  struct Cell *cell;
+
+  sprintf(buf,"%" PRIu64 ".dump.csv",clock);
+  d = fopen(buf,"w");
+  if (!d) {
+    fprintf(stderr,"[WARNING] Could not open %s for writing.\n",buf);
+    return;
+  }
+
+  fprintf(stderr,"[INFO] Dumping viable cells to %s\n",buf);
+
+  for(i=0;i<POND_SIZE;++i) {
+    cell = &pond->cells[i];
+    dumpCell(d, cell);
+  }
+  fclose(d);
+}
+#endif //DUMP_FREQUENCY
 
 /**
  * Get a neighbor in the pond
@@ -262,428 +283,2486 @@ static inline uint8_t getColor(struct Cell *c)
 }
 #endif //USE_SDL
 
+#ifdef USE_SDL
 /**
- * Main method
+ * Handles pending SDL events and pushes the screen to the display
  *
- * @param argc Number of args
- * @param argv Argument array
+ * @param pond Pond on the screen
+ * @param screen Surface the pond is drawn on
  */
-int main(int argc,char **argv)
+static void pollSDL(struct Pond *const pond, SDL_Surface *screen)
 {
-  uint64_t i = 0, x = 0, y = 0, idx = 0;
-
-  /* Buffer used for execution output of candidate offspring */
-  genome_t outputBuf[POND_DEPTH_SYSWORDS];
-
-  /* Seed and init the random number generator */
-  init_genrand();
-  for(i=0;i<1024;++i){
-    getRandom();
-  }
-
-  /* Reset per-report stat counters */
-  for(x=0;x<sizeof(statCounters);++x){
-    ((uint8_t *)&statCounters)[x] = (uint8_t)0;
-  }
-
-  /* Set up SDL if we're using it */
-#ifdef USE_SDL
-  SDL_Surface *screen;
   SDL_Event sdlEvent;
-  if (SDL_Init(SDL_INIT_VIDEO) < 0 ) {
-    fprintf(stderr,"*** Unable to init SDL: %s ***\n",SDL_GetError());
-    exit(1);
-  }
-  atexit(SDL_Quit);
-  SDL_WM_SetCaption("nanopond","nanopond");
-  screen = SDL_SetVideoMode(POND_SIZE_X,POND_SIZE_Y,8,SDL_SWSURFACE);
-  if (!screen) {
-    fprintf(stderr, "*** Unable to create SDL window: %s ***\n", SDL_GetError());
-    exit(1);
-  }
   const uint64_t sdlPitch = screen->pitch;
-#endif /* USE_SDL */
+  uint64_t x, y;
 
-  /* Clear the pond and initialize all genomes to 0xffff... */
-  uint64_t p;
-  for(y=0;y<POND_SIZE_Y;++y) {
-    for(x=0;x<POND_SIZE_X;++x) {
-      p = y*(uint64_t)POND_SIZE_X+x;
-      pond[p].ID = 0;
-      pond[p].parentID = 0;
-      pond[p].lineage = 0;
-      pond[p].generation = 0;
-      pond[p].energy = 0;
-      for(i=0;i<POND_DEPTH_SYSWORDS;++i){
-        pond[p].genome[i] = ~((genome_t)0);
+  while (SDL_PollEvent(&sdlEvent)) {
+    if (sdlEvent.type == SDL_QUIT) {
+      fprintf(stderr,"[QUIT] Quit signal received!\n");
+      exit(0);
+    } else if (sdlEvent.type == SDL_MOUSEBUTTONDOWN) {
+      switch (sdlEvent.button.button) {
+      case SDL_BUTTON_LEFT:
+        fprintf(stderr,"[INTERFACE] Genome of cell at (%d, %d):\n",sdlEvent.button.x, sdlEvent.button.y);
+        dumpCell(stderr, &POND(pond, sdlEvent.button.x, sdlEvent.button.y));
+        break;
+      case SDL_BUTTON_RIGHT:
+        colorScheme = (colorScheme + 1) % MAX_COLOR_SCHEME;
+        fprintf(stderr,"[INTERFACE] Switching to color scheme \"%s\".\n",colorSchemeName[colorScheme]);
+        for (y=0;y<POND_SIZE_Y;++y) {
+          for (x=0;x<POND_SIZE_X;++x)
+            ((uint8_t *)screen->pixels)[x + (y * sdlPitch)] = 0;//getColor(&pond[x][y]);
+        }
+        break;
       }
+    }
+  }
+  SDL_UpdateRect(screen,0,0,POND_SIZE_X,POND_SIZE_Y);
+}
+#endif /* USE_SDL */
 
-      /* Space is toroidal; it wraps at edges */
-      pond[p].lw = (x) ? &POND(x-1, y) : &POND(POND_SIZE_X-1,y);
-      pond[p].re = (x < (POND_SIZE_X-1)) ? &POND(x+1,y) : &POND(0,y);
-      pond[p].un = (y) ? &POND(x,y-1) : &POND(x,POND_SIZE_Y-1);
-      pond[p].ds = (y < (POND_SIZE_Y-1)) ? &POND(x,y+1) : &POND(x,0);
+#ifdef ACTIVE_CELL_SET
+/* Slot value of a cell that is not in the set */
+#define NOT_ACTIVE 0xffffffff
+
+/**
+ * Adds a cell to or removes it from the set of live cells to match
+ * its energy. Removal moves the last cell of the list into the hole.
+ *
+ * @param pond Pond of the cell
+ * @param c Cell whose energy may have changed
+ */
+static inline void syncActive(struct Pond *const pond, struct Cell *const c)
+{
+  const uint32_t i = c - pond->cells;
 
-      //printf("%lu\t%lu\t%lu\t%lu\n", pond[p].lw, pond[p].re, pond[p].un, pond[p].ds);
+  if (c->energy) {
+    if (pond->activeSlot[i] == NOT_ACTIVE) {
+      pond->activeSlot[i] = pond->activeCount;
+      pond->activeCells[pond->activeCount++] = i;
     }
+  } else if (pond->activeSlot[i] != NOT_ACTIVE) {
+    const uint32_t last = pond->activeCells[--pond->activeCount];
+    pond->activeCells[pond->activeSlot[i]] = last;
+    pond->activeSlot[last] = pond->activeSlot[i];
+    pond->activeSlot[i] = NOT_ACTIVE;
   }
+}
 
-  /* Clock is incremented on each core loop */
-  uint64_t clock = 0;
+/**
+ * Gets the number of picks in a row that will land on cells without
+ * energy. Each pick is live with probability activeCount / POND_SIZE,
+ * so the count is geometrically distributed.
+ *
+ * @param pond Pond to pick from
+ * @return Number of empty picks before the next live one
+ */
+static inline uint64_t emptyPicks(const struct Pond *const pond)
+{
+  /* Uniform in (0,1] so the logarithm is finite */
+  const double u = (double)((getRandom() >> 11) + 1) * (1.0 / 9007199254740992.0);
+  const double n = log(u) / log1p(-((double)pond->activeCount / (double)POND_SIZE));
+  return (n < 18446744073709549568.0) ? (uint64_t)n : UINT64_MAX;
+}
 
-  /* This is used to generate unique cell IDs */
-  uint64_t cellIdCounter = 0;
+#endif /* ACTIVE_CELL_SET */
 
-  /* Miscellaneous variables used in the loop */
-  uint64_t currentWord = 0,
-           wordPtr = 0,
-           shiftPtr = 0,
-           inst = 0,
-           tmp = 0;
-  struct Cell *cell = 0,
-              *tmcell = 0;
+/**
+ * Introduces a random cell with a given energy level
+ *
+ * This is called seeding, and introduces both energy and entropy
+ * into the substrate.
+ *
+ * @param pond Pond of the cell
+ * @param cell Cell to overwrite
+ */
+static inline void inflow(struct Pond *const pond, struct Cell *const cell)
+{
+  uint64_t i;
 
-  /* Virtual machine memory pointer register (which
-  * exists in two parts... read the code below...) */
-  uint64_t ptr_wordPtr = 0;
-  uint64_t ptr_shiftPtr = 0;
+  cell->ID = CELL_ID_POSTINC(pond);
+  cell->parentID = 0;
+  cell->lineage = cell->ID;
+  cell->generation = 0;
+#ifdef INFLOW_RATE_VARIATION
+  cell->energy += INFLOW_RATE_BASE + (getRandom() % INFLOW_RATE_VARIATION);
+#else
+  cell->energy += INFLOW_RATE_BASE;
+#endif /* INFLOW_RATE_VARIATION */
+  for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+    cell->genome[i] = getRandom();
+  }
+  GENOME_CHANGED(cell);
+  ENERGY_CHANGED(pond, cell);
+}
 
-  /* The main "register" */
-  uint64_t reg = 0;
+#ifdef GENOME_DECODE
+#if (POND_DEPTH > 1024)
+#error "GENOME_DECODE keeps a bit per genome word, so POND_DEPTH can be at most 1024"
+#endif
+/**
+ * Decodes a word of a cell's genome into one codon per byte. Codons
+ * are packed low nibble first, so each byte holds two consecutive
+ * codons.
+ *
+ * @param code Decoded genome of the cell
+ * @param cell Cell whose genome it is
+ * @param w Word to decode
+ */
+static void decodeWord(uint8_t *const code, struct Cell *const cell, const uint64_t w)
+{
+  const __m128i mask = _mm_set1_epi8(0xf);
+  const __m128i packed = _mm_loadl_epi64((const __m128i *)&cell->genome[w]);
+  const __m128i lo = _mm_and_si128(packed, mask);
+  const __m128i hi = _mm_and_si128(_mm_srli_epi16(packed, 4), mask);
 
-  /* Which way is the cell facing? */
-  uint64_t facing = 0;
+  _mm_storeu_si128((__m128i *)(code + w * (SYSWORD_BITS / 4)), _mm_unpacklo_epi8(lo, hi));
+  cell->decoded |= ((uint64_t)1) << w;
+}
+#endif /* GENOME_DECODE */
 
-  /* Virtual machine loop/rep stack */
-  uint64_t loopStack_wordPtr[POND_DEPTH];
-  uint64_t loopStack_shiftPtr[POND_DEPTH];
-  uint64_t loopStackPtr = 0;
+#if defined(LOOP_MATCH_TABLE)||defined(MUTATION_COUNTDOWN)
+/**
+ * Gets how many codons will be fetched up to and including the next
+ * one that mutates. Each fetch mutates with probability
+ * MUTATION_RATE / 2^32, so the count is geometrically distributed.
+ *
+ * @return Codons until the next mutation, at least 1
+ */
+static inline uint64_t mutationDistance(void)
+{
+  /* Uniform in (0,1] so the logarithm is finite */
+  const double u = (double)((getRandom() >> 11) + 1) * (1.0 / 9007199254740992.0);
+  const double n = log(u) / log1p(-((double)MUTATION_RATE / 4294967296.0));
+  return (n < 18446744073709549568.0) ? ((uint64_t)n + 1) : UINT64_MAX;
+}
+#endif
 
-  /* Machine flags */
-  uint64_t flags = 0;
+/**
+ * Gets the codon at a position of a genome
+ *
+ * @param genome Packed genome
+ * @param pos Codon position
+ * @return Codon
+ */
+static inline uint64_t genomeCodon(const genome_t *const genome, const uint64_t pos)
+{
+  return (genome[pos / (SYSWORD_BITS / 4)] >> ((pos % (SYSWORD_BITS / 4)) * 4)) & 0xf;
+}
 
-  /* If this is nonzero, we're skipping to matching REP */
-  /* It is incremented to track the depth of a nested set
-  * of LOOP/REP pairs in false state. */
-  uint64_t falseLoopDepth = 0;
+/**
+ * Gets the position execution moves on to from a codon position,
+ * wrapping around at the end of the genome like VM_ADVANCE.
+ *
+ * @param pos Codon position
+ * @return Next codon position
+ */
+static inline uint64_t nextCodon(const uint64_t pos)
+{
+  return (pos + 1 >= POND_DEPTH) ? EXEC_START_CODON : (pos + 1);
+}
 
-  /* If this is nonzero, cell execution stops. This allows us
-  * to avoid the ugly use of a goto to exit the loop. :) */
-  int stop = 0;
+/**
+ * Finds the codons of a word that are equal to a given one
+ *
+ * @param word Word of a genome
+ * @param codon Codon to look for
+ * @return Word with the lowest bit of each matching codon set
+ */
+static inline uint64_t codonsEqual(const uint64_t word, const uint64_t codon)
+{
+  uint64_t x = word ^ (codon * 0x1111111111111111ULL);
+  x |= x >> 1;
+  x |= x >> 2;
+  return ~x & 0x1111111111111111ULL;
+}
 
-  printf("exec_start\n");
-  /* Main loop */
-  for(;;) {
-    /* Stop at STOP_AT if defined */
-#ifdef STOP_AT
-    if (clock >= STOP_AT) {
-    /* Also do a final dump if dumps are enabled */
-#ifdef DUMP_FREQUENCY
-      doDump(clock);
-#endif /* DUMP_FREQUENCY */
-      fprintf(stderr,"[QUIT] STOP_AT clock value reached\n");
-      break;
-    }
-#endif /* STOP_AT */
+#ifdef CODE_CACHE
+#if (POND_DEPTH > 65536)
+#error "LOOP_MATCH_TABLE and VM_BLOCKS need POND_DEPTH to be at most 65536"
+#endif
+/**
+ * Forgets everything derived from the executing genome so far, which
+ * is needed whenever a different genome starts to run or the running
+ * one is written to.
+ *
+ * @param vm Context of the executing cell
+ */
+static inline void forgetCode(struct VMContext *const vm)
+{
+  if (!++vm->codeEpoch) {
+#ifdef LOOP_MATCH_TABLE
+    memset(vm->loopMatch, 0, sizeof(vm->loopMatch));
+#endif
+#ifdef VM_BLOCKS
+    memset(vm->blocks, 0, sizeof(vm->blocks));
+#endif
+    vm->codeEpoch = 1;
+  }
+#ifdef VM_BLOCKS
+  vm->blockOpsUsed = 0;
+#endif
+}
+#endif /* CODE_CACHE */
 
-    /* Increment clock and run reports periodically */
-    /* Clock is incremented at the start, so it starts at 1 */
-    ++clock;
+#ifdef LOOP_MATCH_TABLE
 
-#ifdef REPORT_FREQUENCY
-    if (!(clock % REPORT_FREQUENCY)) {
-      doReport(clock);
-    }
-#endif
+/**
+ * Finds the REP matching a LOOP and remembers it until the matches are
+ * next forgotten. Execution wraps around, so if there is no match
+ * within one pass around the genome the LOOP is at least as deep when
+ * it comes around again, and there is never going to be one.
+ *
+ * @param vm Context of the executing cell
+ * @param genome Genome of the executing cell
+ * @param loop Position of the LOOP codon
+ * @return Match, with length 0 if there is none
+ */
+static inline const struct LoopMatch *findLoopMatch(struct VMContext *const vm, const genome_t *const genome, const uint64_t loop)
+{
+  struct LoopMatch *const m = &vm->loopMatch[loop];
+  uint64_t pos, first, last, events, depth = 1, n = 1;
 
-#ifdef USE_SDL
-    /* Refresh the screen and check for input if SDL enabled */
-    if (!(clock % SDL_REFRESH_FREQUENCY)){
-      while (SDL_PollEvent(&sdlEvent)) {
-        if (sdlEvent.type == SDL_QUIT) {
-          fprintf(stderr,"[QUIT] Quit signal received!\n");
-          exit(0);
-        } else if (sdlEvent.type == SDL_MOUSEBUTTONDOWN) {
-          switch (sdlEvent.button.button) {
-          case SDL_BUTTON_LEFT:
-            fprintf(stderr,"[INTERFACE] Genome of cell at (%d, %d):\n",sdlEvent.button.x, sdlEvent.button.y);
-            dumpCell(stderr, &POND(sdlEvent.button.x,sdlEvent.button.y));
-            break;
-          case SDL_BUTTON_RIGHT:
-            colorScheme = (colorScheme + 1) % MAX_COLOR_SCHEME;
-            fprintf(stderr,"[INTERFACE] Switching to color scheme \"%s\".\n",colorSchemeName[colorScheme]);
-            for (y=0;y<POND_SIZE_Y;++y) {
-              for (x=0;x<POND_SIZE_X;++x)
-                ((uint8_t *)screen->pixels)[x + (y * sdlPitch)] = 0;//getColor(&pond[x][y]);
-            }
-            break;
-          }
+  if (m->epoch != vm->codeEpoch) {
+    m->epoch = vm->codeEpoch;
+    m->length = 0;
+    /* Go a word at a time, stopping only at LOOPs and REPs; n counts
+    * codons fetched up to the first one looked at in the word */
+    for(pos=nextCodon(loop);;pos=nextCodon(pos - first + last)) {
+      first = pos % (SYSWORD_BITS / 4);
+      last = ((pos / (SYSWORD_BITS / 4) == loop / (SYSWORD_BITS / 4))&&(loop >= pos)) ? (loop % (SYSWORD_BITS / 4)) : (SYSWORD_BITS / 4 - 1);
+      events = codonsEqual(genome[pos / (SYSWORD_BITS / 4)], 0x9) | codonsEqual(genome[pos / (SYSWORD_BITS / 4)], 0xa);
+      events &= (~((uint64_t)0) << (first * 4)) & (~((uint64_t)0) >> (SYSWORD_BITS - 4 - last * 4));
+      while (events) {
+        const uint64_t k = pos - first + (__builtin_ctzll(events) / 4);
+        if (genomeCodon(genome, k) == 0x9) {
+          ++depth;
+        } else if (!--depth) {
+          m->length = n + (k - pos);
+          m->end = k;
+          return m;
         }
+        events &= events - 1;
+      }
+      if ((pos <= loop)&&(loop - pos <= last - first)) {
+        break; /* Back at the LOOP */
       }
-      SDL_UpdateRect(screen,0,0,POND_SIZE_X,POND_SIZE_Y);
+      n += last - first + 1;
     }
-#endif /* USE_SDL */
+  }
+  return m;
+}
 
-#ifdef DUMP_FREQUENCY
-    /* Periodically dump the viable population if defined */
-    if (!(clock % DUMP_FREQUENCY)){
-      doDump(clock);
-    }
-#endif /* DUMP_FREQUENCY */
+/**
+ * Skips from a false LOOP straight to its matching REP. Every codon
+ * skipped over, the REP included, still costs one unit of energy and
+ * may mutate, but rather than drawing a random number for each one
+ * the distance to the next mutation is counted down (as it is for all
+ * instructions with MUTATION_COUNTDOWN). If the mutation
+ * falls within the span, the codons before it are skipped, that one is
+ * mutated, and the rest are left to be skipped one at a time as usual
+ * since the mutation may move the end of the loop.
+ *
+ * @param vm Context of the executing cell
+ * @param cell Executing cell
+ * @param loop Position of the false LOOP codon
+ * @param reg Register, which the mutation may change
+ * @param falseLoopDepth Depth of nested false LOOPs, 1 on entry
+ * @param countdown Codons up to and including the next mutation
+ * @return Position of the last codon skipped over
+ */
+static inline uint64_t skipFalseLoop(struct VMContext *const vm, struct Cell *const cell, const uint64_t loop, uint64_t *const reg, uint64_t *const falseLoopDepth, uint64_t *const countdown)
+{
+  const struct LoopMatch *const m = findLoopMatch(vm, cell->genome, loop);
+  const uint64_t n = ((m->length)&&(m->length < cell->energy)) ? m->length : cell->energy;
+  uint64_t pos = loop, depth = 1, inst, tmp;
 
-    if (!(clock % 10000000)) {
-      printf("%"PRIu64"\n", clock);
+  if (*countdown > n) {
+    *countdown -= n;
+    cell->energy -= n;
+    if (cell->energy) {
+      *falseLoopDepth = 0;
+      return m->end;
     }
-
-    /* Introduce a random cell somewhere with a given energy level */
-    /* This is called seeding, and introduces both energy and
-    * entropy into the substrate. This happens every INFLOW_FREQUENCY
-    * clock ticks. */
-    if (!(clock % INFLOW_FREQUENCY)) {
-      idx = getRandom() % POND_SIZE;
-      cell = &pond[idx];
-      cell->ID = cellIdCounter;
-      cell->parentID = 0;
-      cell->lineage = cellIdCounter;
-      cell->generation = 0;
-#ifdef INFLOW_RATE_VARIATION
-      cell->energy += INFLOW_RATE_BASE + (getRandom() % INFLOW_RATE_VARIATION);
-  #else
-      cell->energy += INFLOW_RATE_BASE;
-#endif /* INFLOW_RATE_VARIATION */
-      for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
-        cell->genome[i] = getRandom();
-      }
-      ++cellIdCounter;
-
-#ifdef USE_SDL
-      /* Update the random cell on SDL screen if viz is enabled */
-      if (SDL_MUSTLOCK(screen)){
-        SDL_LockSurface(screen);
+#ifdef EXEC_QUANTUM
+    /* Out of energy, but it may be energy held back for the rest of a
+    * parked execution, so it matters where it stopped */
+    for(tmp=0;tmp<n;++tmp) {
+      pos = nextCodon(pos);
+      inst = genomeCodon(cell->genome, pos);
+      if (inst == 0x9) {
+        ++depth;
+      } else if (inst == 0xa) {
+        --depth;
       }
-      ((uint8_t *)screen->pixels)[x + (y * sdlPitch)] = getColor(cell);
-      if (SDL_MUSTLOCK(screen)){
-        SDL_UnlockSurface(screen);
-      }
-#endif /* USE_SDL */
     }
+    *falseLoopDepth = depth;
+    return pos;
+#else
+    /* Out of energy, so where it stopped no longer matters */
+    return loop;
+#endif
+  }
 
-    /* Pick a random cell to execute */
+  for(tmp=1;tmp<*countdown;++tmp) {
+    pos = nextCodon(pos);
+    inst = genomeCodon(cell->genome, pos);
+    if (inst == 0x9) {
+      ++depth;
+    } else if (inst == 0xa) {
+      --depth;
+    }
+  }
+  pos = nextCodon(pos);
+  inst = genomeCodon(cell->genome, pos);
+  VM_MUTATION(inst, *reg, tmp);
+  if (inst == 0x9) {
+    ++depth;
+  } else if (inst == 0xa) {
+    --depth;
+  }
+  cell->energy -= *countdown;
+  *countdown = mutationDistance();
+  *falseLoopDepth = depth;
+  return pos;
+}
+#endif /* LOOP_MATCH_TABLE */
 
-    idx = getRandom() % POND_SIZE;
-    cell = &pond[idx];
-    x = idx % POND_SIZE_X;
-    y = idx / POND_SIZE_X;
-    //printf("%lu\t%lu\t%lu\t%lu\n", x, y, y * POND_SIZE_X + x, idx);
-//     break;
+#ifdef LOOP_IDIOMS
+/* Most codons between a LOOP and its REP for the loop to be recognized */
+#define LOOP_IDIOM_MAX_BODY 8
 
-    /* Keep track of how many cells have been executed */
-//     statCounters.cellExecutions += 1.0;
+/**
+ * Copies codons of a genome into the output buffer at the same
+ * positions, moving forward (and wrapping around at the end) like the
+ * memory pointer does, until just before the first zero codon.
+ *
+ * @param genome Genome to copy from
+ * @param outputBuf Output buffer to copy into
+ * @param pos Position to start at
+ * @param max Most codons to copy
+ * @return Codons copied
+ */
+static inline uint64_t copyNonzeroCodons(const genome_t *const genome, genome_t *const outputBuf, uint64_t pos, const uint64_t max)
+{
+  uint64_t n = 0, first, count, zeros, mask;
 
-    /* Reset the state of the VM prior to execution */
-    if (flags & FLAG_BUF) {
-      for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
-        outputBuf[i] = ~((uint64_t)0); /* ~0 == 0xfffff... */
-      }
+  while (n < max) {
+    first = pos % (SYSWORD_BITS / 4);
+    count = SYSWORD_BITS / 4 - first;
+    if (count > max - n) {
+      count = max - n;
     }
-    ptr_wordPtr = 0;
-    ptr_shiftPtr = 0;
-    reg = 0;
-    loopStackPtr = 0;
-    wordPtr = EXEC_START_WORD;
-    shiftPtr = EXEC_START_BIT;
-    facing = 0;
-    falseLoopDepth = 0;
-    stop = 0;
-    flags = 0;
-
-    /* We use a currentWord buffer to hold the word we're
-     * currently working on.  This speeds things up a bit
-     * since it eliminates a pointer dereference in the
-     * inner loop. We have to be careful to refresh this
-     * whenever it might have changed... take a look at
-     * the code. :) */
-    currentWord = cell->genome[0];
-
-    /* Core execution loop */
-    while (cell->energy&&(!stop)) {
-      /* Get the next instruction */
-      inst = (currentWord >> shiftPtr) & 0xf;
-
-      /* Randomly frob either the instruction or the register with a
-      * probability defined by MUTATION_RATE. This introduces variation,
-      * and since the variation is introduced into the state of the VM
-      * it can have all manner of different effects on the end result of
-      * replication: insertions, deletions, duplications of entire
-      * ranges of the genome, etc. */
-      if ((getRandom() & 0xffffffff) < MUTATION_RATE) {
-        tmp = getRandom(); /* Call getRandom() only once for speed */
-        if (tmp & 0x80){ /* Check for the 8th bit to get random boolean */
-          inst = tmp & 0xf; /* Only the first four bits are used here */
-        } else {
-          reg = tmp & 0xf;
-        }
-      }
-
-      /* Each instruction processed costs one unit of energy */
-      --cell->energy;
-
-      /* Execute the instruction */
-      if (falseLoopDepth) {
-        DEBUG_VM("%"PRIx64 " :\texecute:\tNOP\tloopDepth: %"PRIu64"\n", VM_GETPOS(wordPtr, shiftPtr), falseLoopDepth);
-        /* Skip forward to matching REP if we're in a false loop. */
-        if (inst == 0x9){ /* Increment false LOOP depth */
-          ++falseLoopDepth;
-        } else {
-          if (inst == 0xa){ /* Decrement on REP */
-            --falseLoopDepth;
-          }
+    mask = (count < SYSWORD_BITS / 4) ? ((((uint64_t)1) << (count * 4)) - 1) : ~((uint64_t)0);
+    zeros = (codonsEqual(genome[pos / (SYSWORD_BITS / 4)], 0x0) >> (first * 4)) & mask;
+    if (zeros) {
+      count = __builtin_ctzll(zeros) / 4;
+      mask = (((uint64_t)1) << (count * 4)) - 1;
+    }
+    mask <<= first * 4;
+    outputBuf[pos / (SYSWORD_BITS / 4)] &= ~mask;
+    outputBuf[pos / (SYSWORD_BITS / 4)] |= genome[pos / (SYSWORD_BITS / 4)] & mask;
+    n += count;
+    pos = (pos + count) % POND_DEPTH;
+    if (zeros) {
+      break;
+    }
+  }
+  return n;
+}
+
+/**
+ * Runs the iterations of a loop that is about to go around again all
+ * at once, if the loop is one of those recognized:
+ *
+ * - A copy loop (LOOP READG WRITEB FWD REP), which copies the genome
+ * into the output buffer until it reads a zero codon. The codons up
+ * to the zero one are copied in bulk, and the iteration that reads it
+ * is left to the interpreter.
+ *
+ * - A loop whose body, run once more from the current state, leaves
+ * everything as it was (LOOP REP, LOOP TURN REP, LOOP KILL REP after
+ * the KILL was done...), or moves only the memory pointer without
+ * using memory (LOOP FWD REP). It goes around until the cell runs out
+ * of energy or something mutates.
+ *
+ * Only whole iterations that end before the next mutation are run,
+ * so the mutation is made by the interpreter as usual. The caller pays
+ * for the codons these would have fetched.
+ *
+ * @param cell Executing cell
+ * @param loop Position of the LOOP codon
+ * @param rep Position of the REP codon
+ * @param reg Register
+ * @param ptr Memory pointer as a codon position
+ * @param facing Direction the cell is facing
+ * @param flags Machine flags
+ * @param outputBuf Output buffer
+ * @param countdown Codons up to and including the next mutation
+ * @return Codons fetched by the iterations run, 0 if none were
+ */
+static inline uint64_t runLoopIdiom(struct Cell *const cell, const uint64_t loop, const uint64_t rep, uint64_t *const reg, uint64_t *const ptr, uint64_t *const facing, uint64_t *const flags, genome_t *const outputBuf, const uint64_t countdown)
+{
+  const uint64_t length = rep - loop + 1; /* Codons fetched per iteration */
+  uint64_t iterations, pos, r = *reg, p = *ptr, f = *facing, fl = *flags, absolute = 0;
+
+  /* Either end may have been a mutation rather than what is there */
+  if ((rep <= loop)||(length > LOOP_IDIOM_MAX_BODY + 2)||(genomeCodon(cell->genome, loop) != 0x9)||(genomeCodon(cell->genome, rep) != 0xa)) {
+    return 0;
+  }
+  iterations = ((cell->energy < countdown) ? cell->energy : (countdown - 1)) / length;
+  if (!iterations) {
+    return 0;
+  }
+
+  if ((length == 5)&&(genomeCodon(cell->genome, loop + 1) == 0x5)&&(genomeCodon(cell->genome, loop + 2) == 0x8)&&(genomeCodon(cell->genome, loop + 3) == 0x1)) {
+    /* Never come back around to the word started in, so the words
+    * written are the ones from start to end (see VM_MARK_BUF_SPAN) */
+    if (iterations > POND_DEPTH - SYSWORD_BITS / 4) {
+      iterations = POND_DEPTH - SYSWORD_BITS / 4;
+    }
+    iterations = copyNonzeroCodons(cell->genome, outputBuf, p, iterations);
+    if (iterations) {
+      *reg = genomeCodon(cell->genome, (p + iterations - 1) % POND_DEPTH);
+      *ptr = (p + iterations) % POND_DEPTH;
+      *flags |= FLAG_BUF;
+    }
+    return iterations * length;
+  }
+
+  /* Run the body once more on copies of the state, giving up at
+  * anything that would change the genome or a neighbor */
+  for(pos=loop+1;pos<rep;++pos) {
+    switch(genomeCodon(cell->genome, pos)) {
+      case 0x0: /* ZERO */
+        r = 0;
+        p = 0;
+        f = 0;
+        absolute = 1;
+        break;
+      case 0x1: /* FWD */
+        p = (p + 1) % POND_DEPTH;
+        break;
+      case 0x2: /* BACK */
+        p = (p + POND_DEPTH - 1) % POND_DEPTH;
+        break;
+      case 0x3: /* INC */
+        r = (r + 1) & 0xf;
+        break;
+      case 0x4: /* DEC */
+        r = (r - 1) & 0xf;
+        break;
+      case 0x5: /* READG */
+        r = genomeCodon(cell->genome, p);
+        absolute = 1;
+        break;
+      case 0x6: /* WRITEG of what is there already */
+        if (genomeCodon(cell->genome, p) != r) {
+          return 0;
         }
-      } else {
-        /* If we're not in a false LOOP/REP, execute normally */
-        DEBUG_VM("%"PRIx64 " :\texecute: %"PRIx64"\t", VM_GETPOS(wordPtr, shiftPtr), inst);
-        /* Keep track of execution frequencies for each instruction */
-        //statCounters.instructionExecutions[inst] += 1.0;
-
-        switch(inst) {
-          case 0x0: /* ZERO: Zero VM state registers */
-            VM_ZERO(reg, ptr_wordPtr, ptr_shiftPtr, facing);
-            break;
-          case 0x1: /* FWD: Increment the pointer (wrap at end) */
-            VM_FWD(reg, ptr_wordPtr, ptr_shiftPtr);
-            break;
-          case 0x2: /* BACK: Decrement the pointer (wrap at beginning) */
-            VM_BACK(reg, ptr_wordPtr, ptr_shiftPtr);
-            break;
-          case 0x3: /* INC: Increment the register */
-            VM_INC(reg, 1);
-            break;
-          case 0x4: /* DEC: Decrement the register */
-            VM_DEC(reg, 1);
-            break;
-          case 0x5: /* READG: Read into the register from genome */
-            VM_READG(reg, ptr_wordPtr, ptr_shiftPtr, cell->genome);
-            break;
-          case 0x6: /* WRITEG: Write out from the register to genome */
-            VM_WRITEG(reg, ptr_wordPtr, ptr_shiftPtr, cell->genome);
-            break;
-          case 0x7: /* READB: Read into the register from buffer */
-            VM_READB(reg, ptr_wordPtr, ptr_shiftPtr, outputBuf);
-            break;
-          case 0x8: /* WRITEB: Write out from the register to buffer */
-            VM_WRITEB(reg, ptr_wordPtr, ptr_shiftPtr, outputBuf);
-            flags |= FLAG_BUF;
-            break;
-          case 0x9: /* LOOP: Jump forward to matching REP if register is zero */
-            VM_LOOP(reg, wordPtr, shiftPtr, loopStackPtr, loopStack_wordPtr, loopStack_shiftPtr, stop, falseLoopDepth);
-            break;
-          case 0xa: /* REP: Jump back to matching LOOP if register is nonzero */
-            VM_REP(reg, wordPtr, shiftPtr, loopStackPtr, loopStack_wordPtr, loopStack_shiftPtr);
-            break;
-          case 0xb: /* TURN: Turn in the direction specified by register */
-            flags &= ~(FLAG_SHARED | FLAG_KILLED);
-            VM_TURN(reg, facing);
-            break;
-          case 0xc: /* XCHG: Skip next instruction and exchange value of register with it */
-            VM_XCHG(reg, wordPtr, shiftPtr, cell->genome, tmp);
-            break;
-          case 0xd: /* KILL: Blow away neighboring cell if allowed with penalty on failure */
-            if (!(flags & FLAG_KILLED)) {
-              flags |= FLAG_KILLED;
-              VM_KILL(reg, cell, tmcell, facing, tmp);
-            }
-            break;
-          case 0xe: /* SHARE: Equalize energy between self and neighbor if allowed */
-            if (!(flags & FLAG_SHARED)) {
-              flags |= FLAG_SHARED;
-              VM_SHARE(reg, cell, tmcell, facing, tmp);
-            }
+        absolute = 1;
+        break;
+      case 0x7: /* READB */
+        r = genomeCodon(outputBuf, p);
+        absolute = 1;
+        break;
+      case 0x8: /* WRITEB of what is there already */
+        if (genomeCodon(outputBuf, p) != r) {
+          return 0;
+        }
+        fl |= FLAG_BUF;
+        absolute = 1;
+        break;
+      case 0xb: /* TURN */
+        fl &= ~(FLAG_SHARED | FLAG_KILLED);
+        f = r & 3;
+        break;
+      case 0xd: /* KILL that was done already */
+        if (!(fl & FLAG_KILLED)) {
+          return 0;
+        }
+        break;
+      case 0xe: /* SHARE that was done already */
+        if (!(fl & FLAG_SHARED)) {
+          return 0;
+        }
+        break;
+      default: /* LOOP, REP, XCHG, STOP */
+        return 0;
+    }
+  }
+
+  if ((!r)||(r != *reg)||(f != *facing)||(fl != *flags)) {
+    return 0;
+  }
+  if (p != *ptr) {
+    if (absolute) {
+      return 0;
+    }
+    *ptr = (*ptr + iterations * ((p + POND_DEPTH - *ptr) % POND_DEPTH)) % POND_DEPTH;
+  }
+  return iterations * length;
+}
+#endif /* LOOP_IDIOMS */
+
+#ifdef CYCLE_DETECTION
+#if (POND_DEPTH > 65536)
+#error "CYCLE_DETECTION needs POND_DEPTH to be at most 65536"
+#endif
+/**
+ * Looks up the state a REP that is jumping back left the last time,
+ * and remembers the current one instead. If they are the same, with no
+ * effect counted and no mutation in between (no mutation means the
+ * countdown went down by exactly the codons executed, since one would
+ * have drawn it anew), the execution is in a cycle that will go on
+ * until the cell runs out of energy or something mutates. As many
+ * whole cycles as end before either are then skipped, and the next
+ * mutation is made by the interpreter as usual. The caller pays for
+ * the codons these would have fetched.
+ *
+ * @param vm Context of the executing cell
+ * @param cell Executing cell
+ * @param rep Position of the REP codon
+ * @param reg Register
+ * @param ptr Memory pointer as a codon position
+ * @param facing Direction the cell is facing
+ * @param flags Machine flags
+ * @param loopStackPtr Depth of the loop stack after the REP
+ * @param effects Effects counted so far
+ * @param executed Codons executed so far
+ * @param countdown Codons up to and including the next mutation
+ * @return Codons fetched by the cycles skipped, 0 if none were
+ */
+static inline uint64_t findCycle(struct VMContext *const vm, struct Cell *const cell, const uint64_t rep, const uint64_t reg, const uint64_t ptr, const uint64_t facing, const uint64_t flags, const uint64_t loopStackPtr, const uint64_t effects, const uint64_t executed, const uint64_t countdown)
+{
+  struct CycleState *const s = &vm->cycles[rep & (CYCLE_SLOTS - 1)];
+  uint64_t length, skipped = 0;
+
+  if ((s->effects == effects)&&(s->rep == rep)&&(s->reg == reg)&&(s->ptr == ptr)&&(s->facing == facing)&&(s->flags == flags)&&(s->loopStackPtr == loopStackPtr)&&(s->countdown - countdown == executed - s->executed)) {
+    length = executed - s->executed;
+    skipped = (((cell->energy < countdown) ? cell->energy : (countdown - 1)) / length) * length;
+  }
+
+  s->effects = effects;
+  s->executed = executed + skipped;
+  s->countdown = countdown - skipped;
+  s->rep = (uint16_t)rep;
+  s->reg = (uint16_t)reg;
+  s->ptr = (uint16_t)ptr;
+  s->facing = (uint16_t)facing;
+  s->flags = (uint16_t)flags;
+  s->loopStackPtr = (uint16_t)loopStackPtr;
+  return skipped;
+}
+#endif /* CYCLE_DETECTION */
+
+#ifdef EXEC_QUANTUM
+#if (POND_DEPTH > 65536)
+#error "EXEC_QUANTUM needs POND_DEPTH to be at most 65536"
+#endif
+/* State every execution that is not resumed starts from */
+static const struct ParkedExec freshExec = { .ip = EXEC_START_CODON };
+#endif /* EXEC_QUANTUM */
+
+#ifdef VM_BLOCKS
+/* Instructions that can be part of a block: everything but those that
+ * jump, write to the genome, touch a neighbor or stop */
+#define BLOCK_INSTRUCTIONS ((1 << 0x0) | (1 << 0x1) | (1 << 0x2) | (1 << 0x3) | (1 << 0x4) | (1 << 0x5) | (1 << 0x7) | (1 << 0x8) | (1 << 0xb))
+
+/**
+ * Finds the block starting at a codon position, and remembers it until
+ * the code is next forgotten. Most code runs only once per execution,
+ * so a block is only compiled the second time execution gets to it. A
+ * block runs to the first instruction that cannot be part of one or to
+ * the end of the genome.
+ *
+ * @param vm Context of the executing cell
+ * @param genome Genome of the executing cell
+ * @param start Codon position the block starts at
+ * @return Block, or 0 or length 0 if there is none worth running
+ */
+static inline const struct Block *findBlock(struct VMContext *const vm, const genome_t *const genome, const uint64_t start)
+{
+  struct Block *const b = &vm->blocks[start];
+  struct BlockOp *op = 0;
+  uint64_t pos, inst;
+
+  /* Most places are not the start of a block of two or more, and it
+  * is quicker to look at the genome than at the table to tell */
+  if ((start + 1 >= POND_DEPTH)||(!((BLOCK_INSTRUCTIONS >> genomeCodon(genome, start)) & (BLOCK_INSTRUCTIONS >> genomeCodon(genome, start + 1)) & 1))) {
+    return 0;
+  }
+  if (b->epoch != vm->codeEpoch) {
+    b->epoch = vm->codeEpoch;
+    b->length = 0;
+    b->visited = 1;
+  } else if (b->visited) {
+    b->visited = 0;
+    b->first = vm->blockOpsUsed;
+    b->ops = 0;
+    for(pos=start;pos<POND_DEPTH;++pos) {
+      inst = genomeCodon(genome, pos);
+      if (!((BLOCK_INSTRUCTIONS >> inst) & 1)) {
+        break;
+      }
+      /* FWD/BACK and INC/DEC become one operation each */
+      if ((inst == 0x1)||(inst == 0x2)) {
+        if ((!op)||(op->inst != 0x1)) {
+          if (vm->blockOpsUsed >= BLOCK_OPS) {
             break;
-          case 0xf: /* STOP: End execution */
-            VM_STOP(stop);
+          }
+          op = &vm->blockOps[vm->blockOpsUsed++];
+          op->inst = 0x1;
+          op->arg = 0;
+        }
+        op->arg = (op->arg + ((inst == 0x1) ? 1 : (POND_DEPTH - 1))) % POND_DEPTH;
+      } else if ((inst == 0x3)||(inst == 0x4)) {
+        if ((!op)||(op->inst != 0x3)) {
+          if (vm->blockOpsUsed >= BLOCK_OPS) {
             break;
+          }
+          op = &vm->blockOps[vm->blockOpsUsed++];
+          op->inst = 0x3;
+          op->arg = 0;
         }
-      }
-
-      /* Advance the shift and word pointers, and loop around
-      * to the beginning at the end of the genome. */
-      if ((shiftPtr += 4) >= SYSWORD_BITS) {
-        if (++wordPtr >= POND_DEPTH_SYSWORDS) {
-          wordPtr = EXEC_START_WORD;
-          shiftPtr = EXEC_START_BIT;
-        } else {
-          shiftPtr = 0;
+        op->arg = (op->arg + ((inst == 0x3) ? 1 : 0xf)) & 0xf;
+      } else if ((!op)||(op->inst != inst)) {
+        if (vm->blockOpsUsed >= BLOCK_OPS) {
+          break;
         }
-        currentWord = cell->genome[wordPtr];
+        op = &vm->blockOps[vm->blockOpsUsed++];
+        op->inst = inst;
+        op->arg = 0;
       }
     }
+    b->length = pos - start;
+    b->ops = vm->blockOpsUsed - b->first;
+    /* A block of one instruction saves nothing */
+    if (b->length < 2) {
+      b->length = 0;
+      vm->blockOpsUsed = b->first;
+    }
+  }
+  return b;
+}
+#endif /* VM_BLOCKS */
 
-    /* Copy outputBuf into neighbor if access is permitted and there
-    * is energy there to make something happen. There is no need
-    * to copy to a cell with no energy, since anything copied there
-    * would never be executed and then would be replaced with random
-    * junk eventually. See the seeding code in the main loop above. */
-    DEBUG_VM("POSTEXEC:\tcopybuf: \t");
-    if ((flags & FLAG_BUF) && (outputBuf[0] & 0xff) != 0xff) {
-      tmcell = getNeighbor(cell,facing);
-      if ((tmcell->energy)&&accessAllowed(tmcell,reg,0)) {
-        DEBUG_VM("SUCCESS\n");
-        /* Log it if we're replacing a viable cell */
-        if (tmcell->generation > 2) {
-          ++statCounters.viableCellsReplaced;
-        }
+#ifdef VM_JIT
+#include "nanopond-jit.h"
+#endif
 
-        tmcell->ID = ++cellIdCounter;
-        tmcell->parentID = cell->ID;
-        tmcell->lineage = cell->lineage; /* Lineage is copied in offspring */
-        tmcell->generation = cell->generation + 1;
-        for(i=0;i<POND_DEPTH_SYSWORDS;++i){
-          tmcell->genome[i] = outputBuf[i];
-        }
-      } else {
-        DEBUG_VM("FAILED\n");
+#ifdef TRACE_CACHE
+#if (POND_DEPTH > 1024)
+#error "TRACE_CACHE needs POND_DEPTH to be at most 1024 (a bit per genome word)"
+#endif
+/**
+ * Records the trace of the genome of a trace entry: executes it from
+ * the start until the next step would depend on something other than
+ * the genome (a KILL or SHARE, which look at a neighbor, or a WRITEG or
+ * XCHG that changes a codon) or limit codons are fetched. The output
+ * buffer starts out cleared, which it always is when a cell starts.
+ * The words of the genome the trace depends on are noted in read.
+ *
+ * @param t Trace entry holding the genome
+ * @param limit Most codons to fetch
+ */
+static void recordTrace(struct Trace *const t, const uint64_t limit)
+{
+  const genome_t *const genome = t->genome;
+  uint64_t ip = EXEC_START_CODON, next, inst, n = 0;
+  uint64_t reg = 0, ptr = 0, facing = 0, flags = 0, falseLoopDepth = 0;
+  uint64_t loopStackPtr = 0, stop = 0, i;
+
+  for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+    t->bufWritten[i] = 0;
+    t->buf[i] = ~((genome_t)0);
+  }
+  t->complete = 1;
+  t->read = 1;
+
+  while (!stop) {
+    if (n >= limit) {
+      t->complete = 0;
+      break;
+    }
+    inst = genomeCodon(genome, ip);
+    next = nextCodon(ip);
+    t->read |= ((uint64_t)1) << (ip / (SYSWORD_BITS / 4));
+
+    if (falseLoopDepth) {
+      if (inst == 0x9) {
+        ++falseLoopDepth;
+      } else if (inst == 0xa) {
+        --falseLoopDepth;
       }
     } else {
-      DEBUG_VM("NOT MODIFIED\n");
+      /* Stop short of what depends on more than the genome */
+      if ((inst == 0x5)||(inst == 0x6)) {
+        t->read |= ((uint64_t)1) << (ptr / (SYSWORD_BITS / 4));
+      } else if (inst == 0xc) {
+        t->read |= ((uint64_t)1) << (next / (SYSWORD_BITS / 4));
+      }
+      if (((inst == 0x6)&&(genomeCodon(genome, ptr) != reg))||
+          ((inst == 0x9)&&(reg)&&(loopStackPtr >= TRACE_STACK))||
+          ((inst == 0xc)&&(genomeCodon(genome, next) != reg))||
+          (inst == 0xd)||(inst == 0xe)) {
+        break;
+      }
+
+      switch(inst) {
+        case 0x0: /* ZERO */
+          reg = 0;
+          ptr = 0;
+          facing = 0;
+          break;
+        case 0x1: /* FWD */
+          ptr = (ptr + 1) % POND_DEPTH;
+          break;
+        case 0x2: /* BACK */
+          ptr = (ptr + POND_DEPTH - 1) % POND_DEPTH;
+          break;
+        case 0x3: /* INC */
+          reg = (reg + 1) & 0xf;
+          break;
+        case 0x4: /* DEC */
+          reg = (reg - 1) & 0xf;
+          break;
+        case 0x5: /* READG */
+          reg = genomeCodon(genome, ptr);
+          break;
+        case 0x7: /* READB */
+          reg = genomeCodon(t->buf, ptr);
+          break;
+        case 0x8: /* WRITEB */
+          t->buf[ptr / (SYSWORD_BITS / 4)] &= ~(((genome_t)0xf) << ((ptr % (SYSWORD_BITS / 4)) * 4));
+          t->buf[ptr / (SYSWORD_BITS / 4)] |= reg << ((ptr % (SYSWORD_BITS / 4)) * 4);
+          t->bufWritten[ptr / (SYSWORD_BITS / 4)] |= ((genome_t)0xf) << ((ptr % (SYSWORD_BITS / 4)) * 4);
+          flags |= FLAG_BUF;
+          break;
+        case 0x9: /* LOOP */
+          if (reg) {
+            t->loopStack[loopStackPtr++] = (uint16_t)ip;
+          } else {
+            falseLoopDepth = 1;
+          }
+          break;
+        case 0xa: /* REP: back to the LOOP, which runs again */
+          if (loopStackPtr) {
+            --loopStackPtr;
+            if (reg) {
+              next = t->loopStack[loopStackPtr];
+            }
+          }
+          break;
+        case 0xb: /* TURN */
+          flags &= ~(FLAG_SHARED | FLAG_KILLED);
+          facing = reg & 3;
+          break;
+        case 0xc: /* XCHG with a codon holding the register already */
+          next = nextCodon(next);
+          break;
+        case 0xf: /* STOP */
+          stop = 1;
+          break;
+      }
     }
 
-  DEBUG_VM("** EXEC STOP\tiptr: %"PRIx64"\tmemptr: %"PRIx64"\n", VM_GETPOS(wordPtr, shiftPtr), VM_GETPOS(wordPtr, shiftPtr));
-  DEBUG_VM("** EXEC STOP\treg: %"PRIx64"\tfacing: %"PRIu64"\tenergy: %"PRIu64"\n", reg, facing, cell->energy);
+    ++n;
+    ip = next;
+  }
 
-    /* Update the neighborhood on SDL screen to show any changes. */
-#ifdef USE_SDL
-    if (SDL_MUSTLOCK(screen)){
-      SDL_LockSurface(screen);
-    }
-    ((uint8_t *)screen->pixels)[x + (y * sdlPitch)] = getColor(cell);
-    if (x) {
-      ((uint8_t *)screen->pixels)[(x-1) + (y * sdlPitch)] = getColor(&POND(x-1,y));
-      if (x < (POND_SIZE_X-1)) {
-        ((uint8_t *)screen->pixels)[(x+1) + (y * sdlPitch)] = getColor(&POND(x+1,y));
-      } else {
-        ((uint8_t *)screen->pixels)[y * sdlPitch] = getColor(&POND(0,y));
+  t->codons = n;
+  t->reg = (uint16_t)reg;
+  t->ptr = (uint16_t)ptr;
+  t->facing = (uint16_t)facing;
+  t->flags = (uint16_t)flags;
+  t->ip = (uint16_t)ip;
+  t->falseLoopDepth = (uint32_t)falseLoopDepth;
+  t->stop = (uint16_t)stop;
+  t->loopStackPtr = (uint16_t)loopStackPtr;
+}
+
+/**
+ * Finds the trace of a genome about to run, counting the run and
+ * recording the trace once the genome has run TRACE_THRESHOLD times
+ *
+ * @param vm Context of the executing cell
+ * @param genome Genome about to run
+ * @param limit Most codons the cell can fetch before it runs out of
+ * energy or one of them mutates
+ * @return Trace that fits within limit, or 0 to interpret the genome
+ */
+static const struct Trace *findTrace(struct VMContext *const vm, const genome_t *const genome, const uint64_t limit)
+{
+  uint64_t h = genome[0] * 0x9e3779b97f4a7c15ULL, read;
+  struct Trace *t;
+
+  if ((!vm->traces)&&(!(vm->traces = calloc(TRACE_CACHE_SIZE, sizeof(struct Trace))))) {
+    return 0;
+  }
+  h ^= h >> 29;
+  t = &vm->traces[h & (TRACE_CACHE_SIZE - 1)];
+  STAT_INC(traceLookups);
+
+  /* Only the words the trace read have to match, so the rest of the
+  * genome need not even be loaded */
+  read = (t->genome[0] == genome[0]) ? (t->read & ~((uint64_t)1)) : 1;
+  while (read) {
+    if (t->genome[__builtin_ctzll(read)] != genome[__builtin_ctzll(read)]) {
+      break;
+    }
+    read &= read - 1;
+  }
+  if (read) {
+    /* Each other genome landing here wears down the runs counted for
+    * the one already here, so one that keeps running stays */
+    if (t->runs > 1) {
+      --t->runs;
+      return 0;
+    }
+    t->genome[0] = genome[0];
+    t->read = 1;
+    t->runs = 0;
+    t->codons = 0;
+    t->complete = 0;
+  }
+  ++t->runs;
+
+  /* Record the trace, or record it further if it was cut short by a
+  * cell that could fetch fewer codons than this one */
+  if ((t->runs >= TRACE_THRESHOLD)&&(!t->complete)&&(t->codons < limit)) {
+    memcpy(t->genome, genome, sizeof(t->genome));
+    recordTrace(t, limit);
+  }
+  if ((t->codons)&&(t->codons <= limit)) {
+    STAT_INC(traceHits);
+    return t;
+  }
+  return 0;
+}
+#endif /* TRACE_CACHE */
+
+#ifdef VM_TRACE
+/**
+ * Records an event of a traced execution in the ring of a VM context.
+ * Only the thread running the context writes to it, and the event is
+ * published by moving traceHead on after it is written, so
+ * pondTraceRead() can take events from another thread without locks.
+ *
+ * @param vm VM context of the calling thread
+ * @param kind Kind of event (PONDTRACE_*)
+ * @param inst,ip,ptr,reg,facing,value See struct PondTraceEvent
+ */
+static inline void traceEvent(struct VMContext *const vm, const uint64_t kind, const uint64_t inst, const uint64_t ip, const uint64_t ptr, const uint64_t reg, const uint64_t facing, const uint64_t value)
+{
+  const uint64_t head = vm->traceHead;
+  struct PondTraceEvent *const e = &vm->traceRing[head & (VM_TRACE - 1)];
+
+  e->kind = (uint8_t)kind;
+  e->inst = (uint8_t)inst;
+  e->ip = (uint16_t)ip;
+  e->ptr = (uint16_t)ptr;
+  e->reg = (uint8_t)reg;
+  e->facing = (uint8_t)facing;
+  e->value = value;
+  __atomic_store_n(&vm->traceHead, head + 1, __ATOMIC_RELEASE);
+}
+#endif /* VM_TRACE */
+
+/**
+ * Executes a cell until it runs STOP or out of energy, then tries to
+ * place its output buffer into the neighbor it is facing.
+ *
+ * @param vm Virtual machine scratch state of the calling thread
+ * @param cell Cell to execute
+ * @param traced With VM_TRACE, nonzero to record the execution
+ * @return Number of instructions executed (energy burned)
+ */
+#ifdef VM_TRACE
+#ifdef VM_COMPUTED_GOTO
+/* A function with computed gotos cannot be inlined, so traced and
+ * other executions share one copy of it (see VM_EXEC_TABLE) */
+#define RUN_CELL_INLINE
+#else
+/* Traced and other executions each get a copy of their own */
+#define RUN_CELL_INLINE inline __attribute__((always_inline))
+#endif
+static RUN_CELL_INLINE uint64_t runCell(struct VMContext *const vm, struct Cell *const cell, const int traced)
+#else
+static inline uint64_t execCell(struct VMContext *const vm, struct Cell *const cell)
+#endif
+{
+  uint64_t i, executed = 0;
+
+  /* Miscellaneous variables used in the loop */
+  uint64_t inst = 0,
+           tmp = 0;
+  struct Cell *tmcell = 0;
+
+#ifdef GENOME_DECODE
+  /* Instruction pointer into the decoded genome */
+  uint64_t ip = EXEC_START_CODON;
+  uint8_t *const code = cell->code;
+#define VM_IPOS ip
+#define VM_SETIP(pos) VM_JUMP(ip, pos)
+#else
+  uint64_t currentWord = 0,
+           wordPtr = 0,
+           shiftPtr = 0;
+#define VM_IPOS VM_GETPOS(wordPtr, shiftPtr)
+#define VM_SETIP(pos) VM_JUMP(wordPtr, shiftPtr, pos)
+#endif /* GENOME_DECODE */
+
+#ifdef EXEC_QUANTUM
+  /* Slot to park the execution in if it runs for EXEC_QUANTUM
+  * instructions, and the energy held back from the cell meanwhile
+  * (see VM_HOLD_ENERGY) */
+  const uint64_t parkSlot = (cell - vm->pond->cells) & (PARK_SLOTS - 1);
+  struct ParkedExec *const park = &vm->pond->parked[parkSlot];
+  const struct ParkedExec *from = &freshExec;
+  uint64_t energyHeld = 0;
+#define VM_RESUMED (from != &freshExec)
+#else
+#define VM_RESUMED 0
+#endif /* EXEC_QUANTUM */
+
+  /* Records the instruction just fetched with the codon it came from,
+  * if the execution is traced */
+#define VM_TRACE_INST() \
+  VM_TRACE_EVENT(falseLoopDepth ? PONDTRACE_SKIP : PONDTRACE_INST, \
+    inst | (((cell->genome[VM_IPOS / (SYSWORD_BITS / 4)] >> ((VM_IPOS % (SYSWORD_BITS / 4)) * 4)) & 0xf) << 4), \
+    VM_IPOS, VM_GETPOS(ptr_wordPtr, ptr_shiftPtr), VM_ENERGY_LEFT)
+
+#ifdef VM_BLOCKS
+  /* Block about to run and where it is in its operations */
+  const struct Block *blk = 0;
+  uint64_t blkOp = 0;
+
+#ifndef VM_COMPUTED_GOTO
+  /* Set where a block may start (see the core execution loop) */
+  int blockEntry = 1;
+#endif
+
+  /* Runs the block starting at the instruction pointer, if there is
+  * one and it can run through without the cell running out of energy
+  * or one of its codons mutating, and then does done. */
+#define VM_RUN_BLOCK(done) \
+  blk = findBlock(vm, cell->genome, VM_IPOS); \
+  if ((VM_SHORTCUTS)&&(blk)&&(blk->length)&&(blk->length <= cell->energy)&&(blk->length < mutationCountdown)) { \
+    DEBUG_VM("%"PRIx64 " :\tblock: %"PRIu64" codons\n", VM_IPOS, (uint64_t)blk->length); \
+    for(blkOp=blk->first;blkOp<(uint64_t)blk->first+blk->ops;++blkOp) { \
+      switch(vm->blockOps[blkOp].inst) { \
+        case 0x0: \
+          VM_ZERO(reg, ptr_wordPtr, ptr_shiftPtr, facing); \
+          break; \
+        case 0x1: \
+          VM_MOVE(ptr_wordPtr, ptr_shiftPtr, vm->blockOps[blkOp].arg); \
+          break; \
+        case 0x3: \
+          VM_INC(reg, vm->blockOps[blkOp].arg); \
+          break; \
+        case 0x5: \
+          VM_READG(reg, ptr_wordPtr, ptr_shiftPtr, cell->genome); \
+          break; \
+        case 0x7: \
+          VM_READB(reg, ptr_wordPtr, ptr_shiftPtr, outputBuf); \
+          break; \
+        case 0x8: \
+          VM_WRITEB(reg, ptr_wordPtr, ptr_shiftPtr, outputBuf); \
+          flags |= FLAG_BUF; \
+          break; \
+        case 0xb: \
+          flags &= ~(FLAG_SHARED | FLAG_KILLED); \
+          VM_TURN(reg, facing); \
+          break; \
+      } \
+    } \
+    cell->energy -= blk->length; \
+    mutationCountdown -= blk->length; \
+    executed += blk->length; \
+    tmp = VM_IPOS + blk->length; \
+    VM_SETIP(tmp); \
+    done; \
+  }
+#endif /* VM_BLOCKS */
+
+  /* Virtual machine memory pointer register (which
+  * exists in two parts... read the code below...) */
+  uint64_t ptr_wordPtr = 0;
+  uint64_t ptr_shiftPtr = 0;
+
+  /* The main "register" */
+  uint64_t reg = 0;
+
+  /* Which way is the cell facing? */
+  uint64_t facing = 0;
+
+  /* Virtual machine loop/rep stack */
+  uint64_t *const loopStack_wordPtr = vm->loopStack_wordPtr;
+#ifndef GENOME_DECODE
+  uint64_t *const loopStack_shiftPtr = vm->loopStack_shiftPtr;
+#endif
+  uint64_t loopStackPtr = 0;
+
+  /* Buffer used for execution output of candidate offspring */
+  genome_t *const outputBuf = vm->outputBuf;
+
+#ifdef BUF_DIRTY_WORDS
+  /* Words of outputBuf written to by this execution (kept here rather
+  * than in the context so writes to the buffer cannot alias it) */
+  uint64_t bufDirty[BUF_DIRTY_SIZE] = { 0 };
+#endif
+
+#ifdef CYCLE_DETECTION
+  /* Effects counted by VM_CYCLE_EFFECT, going on from the last
+  * execution so no state it left can be taken for a repeat */
+  uint64_t cycleEffects = vm->cycleEffects + 1;
+#endif
+
+  /* Machine flags */
+  uint64_t flags = vm->flags;
+
+  /* If this is nonzero, we're skipping to matching REP */
+  /* It is incremented to track the depth of a nested set
+  * of LOOP/REP pairs in false state. */
+  uint64_t falseLoopDepth = 0;
+
+#if defined(LOOP_MATCH_TABLE)||defined(MUTATION_COUNTDOWN)
+  /* Codons to fetch up to and including the next one that mutates */
+  uint64_t mutationCountdown = vm->mutationCountdown;
+#endif
+
+#ifdef VM_JIT
+  /* Compiled code for the genome and the VM state it leaves */
+  JitCode jitCode = 0;
+  struct JitState jit;
+#endif
+
+#ifdef TRACE_CACHE
+  /* Trace replayed at the start of the execution */
+  const struct Trace *trace = 0;
+#endif
+
+  /* If this is nonzero, cell execution stops. This allows us
+  * to avoid the ugly use of a goto to exit the loop. :) */
+  int stop = 0;
+
+  /* Keep track of how many cells have been executed */
+//     statCounters.cellExecutions += 1.0;
+
+  /* Reset the state of the VM prior to execution */
+  if (flags & FLAG_BUF) {
+#ifdef BUF_DIRTY_WORDS
+    /* Only the words written to by the last execution */
+    for(i=0;i<BUF_DIRTY_SIZE;++i) {
+      while (vm->bufDirty[i]) {
+        outputBuf[i * 64 + __builtin_ctzll(vm->bufDirty[i])] = ~((uint64_t)0);
+        vm->bufDirty[i] &= vm->bufDirty[i] - 1;
       }
-    } else {
-      ((uint8_t *)screen->pixels)[(POND_SIZE_X-1) + (y * sdlPitch)] = getColor(&POND(POND_SIZE_X-1,y));
-      ((uint8_t *)screen->pixels)[1 + (y * sdlPitch)] = getColor(&POND(1,y));
     }
-    if (y) {
-      ((uint8_t *)screen->pixels)[x + ((y-1) * sdlPitch)] = getColor(&POND(x,y-1));
-      if (y < (POND_SIZE_Y-1)){
-        ((uint8_t *)screen->pixels)[x + ((y+1) * sdlPitch)] = getColor(&POND(x,y+1));
-      } else {
-        ((uint8_t *)screen->pixels)[x] = getColor(&POND(x,0));
+#else
+    for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+      outputBuf[i] = ~((uint64_t)0); /* ~0 == 0xfffff... */
+    }
+#endif
+  }
+  flags = 0;
+  VM_FORGET_CODE();
+
+#ifdef EXEC_QUANTUM
+  /* Go on from where the cell's last execution was parked, unless the
+  * cell has been killed or replaced since, or else from the start */
+  if (vm->pond->parkedCells[parkSlot] == cell) {
+    vm->pond->parkedCells[parkSlot] = 0;
+    if (park->ID == cell->ID) {
+      from = park;
+    }
+  }
+  reg = from->reg;
+  ptr_wordPtr = from->ptr / (SYSWORD_BITS / 4);
+  ptr_shiftPtr = (from->ptr % (SYSWORD_BITS / 4)) * 4;
+  facing = from->facing;
+  flags = from->flags;
+  falseLoopDepth = from->falseLoopDepth;
+  loopStackPtr = from->loopStackPtr;
+  for(i=0;i<loopStackPtr;++i) {
+#ifdef GENOME_DECODE
+    loopStack_wordPtr[i] = from->loopStack[i];
+#else
+    loopStack_wordPtr[i] = from->loopStack[i] / (SYSWORD_BITS / 4);
+    loopStack_shiftPtr[i] = (from->loopStack[i] % (SYSWORD_BITS / 4)) * 4;
+#endif
+  }
+  if (flags & FLAG_BUF) {
+    for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+      outputBuf[i] = from->outputBuf[i];
+      VM_MARK_BUF(i);
+    }
+  }
+#endif /* EXEC_QUANTUM */
+
+#ifdef VM_JIT
+  /* Run compiled code if the genome is hot, and then interpret from
+  * wherever it stopped (if it did before the cell did) */
+  if ((VM_SHORTCUTS)&&(cell->energy >= JIT_MIN_ENERGY)&&((jitCode = jitFind(vm, cell)))) {
+    memset(&jit, 0, sizeof(jit));
+    jit.energy = cell->energy;
+    jit.countdown = mutationCountdown;
+    jit.genome = cell->genome;
+    jit.outputBuf = outputBuf;
+    jit.loopStack = loopStack_wordPtr;
+    jit.vm = vm;
+    jit.cell = cell;
+    jitCode(&jit);
+    /* Compiled code writes to the packed genome only */
+    if (jit.wrote) {
+      GENOME_CHANGED(cell);
+      VM_FORGET_CODE();
+    }
+    cell->energy = jit.energy;
+    executed += mutationCountdown - jit.countdown;
+    mutationCountdown = jit.countdown;
+    reg = jit.reg;
+    ptr_wordPtr = jit.ptr / (SYSWORD_BITS / 4);
+    ptr_shiftPtr = (jit.ptr % (SYSWORD_BITS / 4)) * 4;
+    facing = jit.facing;
+    flags = jit.flags;
+#ifdef BUF_DIRTY_WORDS
+    /* Compiled code does not say which words it wrote to */
+    if (flags & FLAG_BUF) {
+      for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+        VM_MARK_BUF(i);
       }
-    } else {
-        ((uint8_t *)screen->pixels)[x + ((POND_SIZE_Y-1) * sdlPitch)] = getColor(&POND(x,POND_SIZE_Y-1));
-        ((uint8_t *)screen->pixels)[x + sdlPitch] = getColor(&POND(x,1));
     }
-    if (SDL_MUSTLOCK(screen)){
-      SDL_UnlockSurface(screen);
+#endif
+    falseLoopDepth = jit.falseLoopDepth;
+    stop = (int)jit.stop;
+    loopStackPtr = jit.lsp;
+#ifndef GENOME_DECODE
+    /* Compiled code keeps codon positions on the loop stack */
+    for(i=0;i<loopStackPtr;++i) {
+      loopStack_shiftPtr[i] = (loopStack_wordPtr[i] % (SYSWORD_BITS / 4)) * 4;
+      loopStack_wordPtr[i] /= (SYSWORD_BITS / 4);
+    }
+#endif
+  }
+#endif /* VM_JIT */
+
+#ifdef TRACE_CACHE
+  /* Replay what the genome does up to the first step that depends on
+  * more than the genome, and interpret from there */
+  if ((VM_SHORTCUTS)&&(cell->energy)&&((trace = findTrace(vm, cell->genome, (cell->energy < mutationCountdown) ? cell->energy : (mutationCountdown - 1))))) {
+    cell->energy -= trace->codons;
+    executed += trace->codons;
+    mutationCountdown -= trace->codons;
+    reg = trace->reg;
+    ptr_wordPtr = trace->ptr / (SYSWORD_BITS / 4);
+    ptr_shiftPtr = (trace->ptr % (SYSWORD_BITS / 4)) * 4;
+    facing = trace->facing;
+    flags = trace->flags;
+    falseLoopDepth = trace->falseLoopDepth;
+    stop = trace->stop;
+    loopStackPtr = trace->loopStackPtr;
+    for(i=0;i<loopStackPtr;++i) {
+#ifdef GENOME_DECODE
+      loopStack_wordPtr[i] = trace->loopStack[i];
+#else
+      loopStack_wordPtr[i] = trace->loopStack[i] / (SYSWORD_BITS / 4);
+      loopStack_shiftPtr[i] = (trace->loopStack[i] % (SYSWORD_BITS / 4)) * 4;
+#endif
+    }
+    if (flags & FLAG_BUF) {
+      for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+        outputBuf[i] = (outputBuf[i] & ~trace->bufWritten[i]) | (trace->buf[i] & trace->bufWritten[i]);
+#ifdef BUF_DIRTY_WORDS
+        if (trace->bufWritten[i]) {
+          VM_MARK_BUF(i);
+        }
+#endif
+      }
     }
-#endif /* USE_SDL */
   }
+#endif /* TRACE_CACHE */
+
+#ifndef GENOME_DECODE
+  wordPtr = EXEC_START_WORD;
+  shiftPtr = EXEC_START_BIT;
+  /* We use a currentWord buffer to hold the word we're
+   * currently working on.  This speeds things up a bit
+   * since it eliminates a pointer dereference in the
+   * inner loop. We have to be careful to refresh this
+   * whenever it might have changed... take a look at
+   * the code. :) */
+  currentWord = cell->genome[0];
+#endif /* GENOME_DECODE */
 
+#ifdef VM_JIT
+  if (jitCode) {
+    VM_SETIP(jit.ip);
+  }
+#endif
+#ifdef TRACE_CACHE
+  if (trace) {
+    VM_SETIP(trace->ip);
+  }
+#endif
+#ifdef EXEC_QUANTUM
+  VM_SETIP(from->ip);
+  VM_HOLD_ENERGY();
+#endif
+  VM_TRACE_EVENT(PONDTRACE_START, VM_RESUMED, (cell - vm->pond->cells) % POND_SIZE_X, (cell - vm->pond->cells) / POND_SIZE_X, cell->ID);
+
+#ifdef VM_COMPUTED_GOTO
+  /* Handlers for executing each instruction, and for skipping over it
+  * while looking for the REP that ends a false LOOP */
+  static const void *const execTable[16] = {
+    &&vm_zero, &&vm_fwd, &&vm_back, &&vm_inc, &&vm_dec, &&vm_readg, &&vm_writeg, &&vm_readb,
+    &&vm_writeb, &&vm_loop, &&vm_rep, &&vm_turn, &&vm_xchg, &&vm_kill, &&vm_share, &&vm_stop
+  };
+  static const void *const skipTable[16] = {
+    &&vm_skip, &&vm_skip, &&vm_skip, &&vm_skip, &&vm_skip, &&vm_skip, &&vm_skip, &&vm_skip,
+    &&vm_skip, &&vm_skip_loop, &&vm_skip_rep, &&vm_skip, &&vm_skip, &&vm_skip, &&vm_skip, &&vm_skip
+  };
+
+#ifdef VM_TRACE
+  /* A traced execution dispatches every instruction to vm_trace, which
+  * records it and goes on to its handler, so the others pay nothing
+  * for tracing per instruction */
+  static const void *const traceTable[16] = {
+    &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace,
+    &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace, &&vm_trace
+  };
+  const void *const *const traceExec = traced ? traceTable : execTable;
+  const void *const *const traceSkip = traced ? traceTable : skipTable;
+#define VM_EXEC_TABLE traceExec
+#define VM_SKIP_TABLE traceSkip
+#else
+#define VM_EXEC_TABLE execTable
+#define VM_SKIP_TABLE skipTable
+#endif /* VM_TRACE */
+
+  /* Fetches the next instruction and jumps straight to its handler in
+  * the given table. Every handler ends in its own copy of this, so the
+  * indirect branch of each one is predicted on its own. */
+#define VM_DISPATCH(table) \
+  if ((!cell->energy)||(stop)) { \
+    goto vm_done; \
+  } \
+  VM_FETCH(inst, reg, tmp); \
+  DEBUG_VM("%"PRIx64 " :\t%s: %"PRIx64"\t", VM_IPOS, falseLoopDepth ? "skip" : "execute", inst); \
+  goto *table[inst];
+
+  /* Moves on to the next instruction. Only LOOP and the skip handlers
+  * can enter or leave a false LOOP, so only they look at the depth. */
+#ifdef GENOME_DECODE
+#define VM_STEP() VM_ADVANCE(ip)
+#else
+#define VM_STEP() VM_ADVANCE(wordPtr, shiftPtr)
+#endif
+#define VM_NEXT() \
+  VM_STEP(); \
+  VM_DISPATCH(VM_EXEC_TABLE);
+#define VM_NEXT_ANY() \
+  VM_STEP(); \
+  VM_DISPATCH((falseLoopDepth ? VM_SKIP_TABLE : VM_EXEC_TABLE));
+
+  /* Moves on to where a block may start, after an instruction that
+  * cannot be part of one. Blocks are all run from one place. */
+#ifdef VM_BLOCKS
+#define VM_NEXT_ENTRY() \
+  VM_STEP(); \
+  goto vm_block;
+#define VM_NEXT_ANY_ENTRY() \
+  VM_STEP(); \
+  if (!falseLoopDepth) { \
+    goto vm_block; \
+  } \
+  VM_DISPATCH(VM_SKIP_TABLE);
+#else
+#define VM_NEXT_ENTRY() VM_NEXT()
+#define VM_NEXT_ANY_ENTRY() VM_NEXT_ANY()
+#endif /* VM_BLOCKS */
+
+  /* Core execution loop. The loop only exists so VM_REP can jump back
+  * with continue, which skips advancing the instruction pointer. */
+  for(;;) {
+#ifdef VM_BLOCKS
+vm_block:
+    if (!falseLoopDepth) {
+      VM_RUN_BLOCK();
+    }
+#endif
+    /* Execution can pick up in the middle of a false LOOP after
+    * VM_JIT or TRACE_CACHE */
+    VM_DISPATCH((falseLoopDepth ? VM_SKIP_TABLE : VM_EXEC_TABLE));
+
+#ifdef VM_TRACE
+vm_trace:
+    VM_TRACE_INST();
+    goto *(falseLoopDepth ? skipTable : execTable)[inst];
+#endif
+
+vm_zero:
+    VM_ZERO(reg, ptr_wordPtr, ptr_shiftPtr, facing);
+    VM_NEXT();
+vm_fwd:
+    VM_FWD(reg, ptr_wordPtr, ptr_shiftPtr);
+    VM_NEXT();
+vm_back:
+    VM_BACK(reg, ptr_wordPtr, ptr_shiftPtr);
+    VM_NEXT();
+vm_inc:
+    VM_INC(reg, 1);
+    VM_NEXT();
+vm_dec:
+    VM_DEC(reg, 1);
+    VM_NEXT();
+vm_readg:
+    VM_READG(reg, ptr_wordPtr, ptr_shiftPtr, cell->genome);
+    VM_NEXT();
+vm_writeg:
+    VM_WRITEG(reg, ptr_wordPtr, ptr_shiftPtr, cell->genome);
+    VM_NEXT_ENTRY();
+vm_readb:
+    VM_READB(reg, ptr_wordPtr, ptr_shiftPtr, outputBuf);
+    VM_NEXT();
+vm_writeb:
+    VM_WRITEB(reg, ptr_wordPtr, ptr_shiftPtr, outputBuf);
+    flags |= FLAG_BUF;
+    VM_NEXT();
+vm_loop:
+#ifdef GENOME_DECODE
+    VM_LOOP(reg, ip, loopStackPtr, loopStack_wordPtr, stop, falseLoopDepth);
+#else
+    VM_LOOP(reg, wordPtr, shiftPtr, loopStackPtr, loopStack_wordPtr, loopStack_shiftPtr, stop, falseLoopDepth);
+#endif
+    VM_NEXT_ANY_ENTRY();
+vm_rep:
+#ifdef GENOME_DECODE
+    VM_REP(reg, ip, loopStackPtr, loopStack_wordPtr);
+#else
+    VM_REP(reg, wordPtr, shiftPtr, loopStackPtr, loopStack_wordPtr, loopStack_shiftPtr);
+#endif
+    VM_NEXT_ENTRY();
+vm_turn:
+    flags &= ~(FLAG_SHARED | FLAG_KILLED);
+    VM_TURN(reg, facing);
+    VM_NEXT();
+vm_xchg:
+#ifdef GENOME_DECODE
+    VM_XCHG(reg, ip, cell->genome, tmp);
+#else
+    VM_XCHG(reg, wordPtr, shiftPtr, cell->genome, tmp);
+#endif
+    VM_NEXT_ENTRY();
+vm_kill:
+    if (!(flags & FLAG_KILLED)) {
+      flags |= FLAG_KILLED;
+      VM_KILL(reg, cell, tmcell, facing, tmp);
+    }
+    VM_NEXT_ENTRY();
+vm_share:
+    if (!(flags & FLAG_SHARED)) {
+      flags |= FLAG_SHARED;
+      VM_SHARE(reg, cell, tmcell, facing, tmp);
+    }
+    VM_NEXT_ENTRY();
+vm_stop:
+    VM_STOP(stop);
+    goto vm_done;
+
+    /* Skipping forward to the matching REP of a false LOOP */
+vm_skip_loop:
+    ++falseLoopDepth;
+    VM_NEXT_ANY();
+vm_skip_rep:
+    --falseLoopDepth;
+    VM_NEXT_ANY_ENTRY();
+vm_skip:
+    VM_NEXT_ANY();
+  }
+#undef VM_SKIP_TABLE
+#undef VM_EXEC_TABLE
+#undef VM_NEXT_ANY_ENTRY
+#undef VM_NEXT_ENTRY
+#undef VM_NEXT_ANY
+#undef VM_STEP
+#undef VM_NEXT
+#undef VM_DISPATCH
+vm_done:
+#else
+  /* Core execution loop */
+  while (cell->energy&&(!stop)) {
+#ifdef VM_BLOCKS
+    /* Blocks can only start after an instruction that cannot be part
+    * of one */
+    if ((blockEntry)&&(!falseLoopDepth)) {
+      blockEntry = 0;
+      VM_RUN_BLOCK(continue);
+    }
+#endif
+
+    /* Get the next instruction, maybe mutated, and pay for it */
+    VM_FETCH(inst, reg, tmp);
+    VM_TRACE_INST();
+
+#ifdef VM_BLOCKS
+    blockEntry = !((BLOCK_INSTRUCTIONS >> inst) & 1);
+#endif
+
+    /* Execute the instruction */
+    if (falseLoopDepth) {
+      DEBUG_VM("%"PRIx64 " :\texecute:\tNOP\tloopDepth: %"PRIu64"\n", VM_IPOS, falseLoopDepth);
+      /* Skip forward to matching REP if we're in a false loop. */
+      if (inst == 0x9){ /* Increment false LOOP depth */
+        ++falseLoopDepth;
+      } else {
+        if (inst == 0xa){ /* Decrement on REP */
+          --falseLoopDepth;
+        }
+      }
+    } else {
+      /* If we're not in a false LOOP/REP, execute normally */
+      DEBUG_VM("%"PRIx64 " :\texecute: %"PRIx64"\t", VM_IPOS, inst);
+      /* Keep track of execution frequencies for each instruction */
+      //statCounters.instructionExecutions[inst] += 1.0;
+
+      switch(inst) {
+        case 0x0: /* ZERO: Zero VM state registers */
+          VM_ZERO(reg, ptr_wordPtr, ptr_shiftPtr, facing);
+          break;
+        case 0x1: /* FWD: Increment the pointer (wrap at end) */
+          VM_FWD(reg, ptr_wordPtr, ptr_shiftPtr);
+          break;
+        case 0x2: /* BACK: Decrement the pointer (wrap at beginning) */
+          VM_BACK(reg, ptr_wordPtr, ptr_shiftPtr);
+          break;
+        case 0x3: /* INC: Increment the register */
+          VM_INC(reg, 1);
+          break;
+        case 0x4: /* DEC: Decrement the register */
+          VM_DEC(reg, 1);
+          break;
+        case 0x5: /* READG: Read into the register from genome */
+          VM_READG(reg, ptr_wordPtr, ptr_shiftPtr, cell->genome);
+          break;
+        case 0x6: /* WRITEG: Write out from the register to genome */
+          VM_WRITEG(reg, ptr_wordPtr, ptr_shiftPtr, cell->genome);
+          break;
+        case 0x7: /* READB: Read into the register from buffer */
+          VM_READB(reg, ptr_wordPtr, ptr_shiftPtr, outputBuf);
+          break;
+        case 0x8: /* WRITEB: Write out from the register to buffer */
+          VM_WRITEB(reg, ptr_wordPtr, ptr_shiftPtr, outputBuf);
+          flags |= FLAG_BUF;
+          break;
+        case 0x9: /* LOOP: Jump forward to matching REP if register is zero */
+#ifdef GENOME_DECODE
+          VM_LOOP(reg, ip, loopStackPtr, loopStack_wordPtr, stop, falseLoopDepth);
+#else
+          VM_LOOP(reg, wordPtr, shiftPtr, loopStackPtr, loopStack_wordPtr, loopStack_shiftPtr, stop, falseLoopDepth);
+#endif
+          break;
+        case 0xa: /* REP: Jump back to matching LOOP if register is nonzero */
+#ifdef GENOME_DECODE
+          VM_REP(reg, ip, loopStackPtr, loopStack_wordPtr);
+#else
+          VM_REP(reg, wordPtr, shiftPtr, loopStackPtr, loopStack_wordPtr, loopStack_shiftPtr);
+#endif
+          break;
+        case 0xb: /* TURN: Turn in the direction specified by register */
+          flags &= ~(FLAG_SHARED | FLAG_KILLED);
+          VM_TURN(reg, facing);
+          break;
+        case 0xc: /* XCHG: Skip next instruction and exchange value of register with it */
+#ifdef GENOME_DECODE
+          VM_XCHG(reg, ip, cell->genome, tmp);
+#else
+          VM_XCHG(reg, wordPtr, shiftPtr, cell->genome, tmp);
+#endif
+          break;
+        case 0xd: /* KILL: Blow away neighboring cell if allowed with penalty on failure */
+          if (!(flags & FLAG_KILLED)) {
+            flags |= FLAG_KILLED;
+            VM_KILL(reg, cell, tmcell, facing, tmp);
+          }
+          break;
+        case 0xe: /* SHARE: Equalize energy between self and neighbor if allowed */
+          if (!(flags & FLAG_SHARED)) {
+            flags |= FLAG_SHARED;
+            VM_SHARE(reg, cell, tmcell, facing, tmp);
+          }
+          break;
+        case 0xf: /* STOP: End execution */
+          VM_STOP(stop);
+          break;
+      }
+    }
+
+    /* Advance the instruction pointer */
+#ifdef GENOME_DECODE
+    VM_ADVANCE(ip);
+#else
+    VM_ADVANCE(wordPtr, shiftPtr);
+#endif
+  }
+#endif /* VM_COMPUTED_GOTO */
+  VM_RELEASE_ENERGY();
+  vm->flags = flags;
+#ifdef CYCLE_DETECTION
+  vm->cycleEffects = cycleEffects;
+#endif
+#ifdef BUF_DIRTY_WORDS
+  for(i=0;i<BUF_DIRTY_SIZE;++i) {
+    vm->bufDirty[i] = bufDirty[i];
+  }
+#endif
+#if defined(LOOP_MATCH_TABLE)||defined(MUTATION_COUNTDOWN)
+  vm->mutationCountdown = mutationCountdown;
+#endif
+  ENERGY_CHANGED(vm->pond, cell);
+
+#ifdef EXEC_QUANTUM
+  /* Park the execution if the quantum ran out before the energy did, and
+  * leave the offspring for when it is done. This drops whatever was
+  * parked in the slot for another cell, which will start over. */
+  if ((cell->energy)&&(!stop)) {
+    vm->pond->parkedCells[parkSlot] = cell;
+    VM_TRACE_EVENT(PONDTRACE_END, 1, VM_IPOS, VM_GETPOS(ptr_wordPtr, ptr_shiftPtr), executed);
+    park->ID = cell->ID;
+    park->reg = (uint16_t)reg;
+    park->ptr = (uint16_t)VM_GETPOS(ptr_wordPtr, ptr_shiftPtr);
+    park->facing = (uint16_t)facing;
+    park->flags = (uint16_t)flags;
+    park->ip = (uint16_t)VM_IPOS;
+    park->falseLoopDepth = falseLoopDepth;
+    park->loopStackPtr = (uint16_t)loopStackPtr;
+    for(i=0;i<loopStackPtr;++i) {
+#ifdef GENOME_DECODE
+      park->loopStack[i] = (uint16_t)loopStack_wordPtr[i];
+#else
+      park->loopStack[i] = (uint16_t)VM_GETPOS(loopStack_wordPtr[i], loopStack_shiftPtr[i]);
+#endif
+    }
+    if (flags & FLAG_BUF) {
+      for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+        park->outputBuf[i] = outputBuf[i];
+      }
+    }
+    return executed;
+  }
+#endif /* EXEC_QUANTUM */
+
+  /* Copy outputBuf into neighbor if access is permitted and there
+  * is energy there to make something happen. There is no need
+  * to copy to a cell with no energy, since anything copied there
+  * would never be executed and then would be replaced with random
+  * junk eventually. See the seeding code in the main loop above. */
+  DEBUG_VM("POSTEXEC:\tcopybuf: \t");
+  if ((flags & FLAG_BUF) && (outputBuf[0] & 0xff) != 0xff) {
+    tmcell = getNeighbor(cell,facing);
+    if ((tmcell->energy)&&accessAllowed(tmcell,reg,0)) {
+      DEBUG_VM("SUCCESS\n");
+      /* Log it if we're replacing a viable cell */
+      if (tmcell->generation > 2) {
+        STAT_INC(viableCellsReplaced);
+      }
+
+      tmcell->ID = CELL_ID_PREINC(vm->pond);
+      VM_TRACE_EVENT(PONDTRACE_OFFSPRING, 0, (tmcell - vm->pond->cells) % POND_SIZE_X, (tmcell - vm->pond->cells) / POND_SIZE_X, tmcell->ID);
+      tmcell->parentID = cell->ID;
+      tmcell->lineage = cell->lineage; /* Lineage is copied in offspring */
+      tmcell->generation = cell->generation + 1;
+#ifdef BUF_DIRTY_WORDS
+      /* Words not written to are all ones, with no need to read them */
+      for(i=0;i<POND_DEPTH_SYSWORDS;++i){
+        tmcell->genome[i] = ((bufDirty[i / 64] >> (i % 64)) & 1) ? outputBuf[i] : ~((genome_t)0);
+      }
+#else
+      for(i=0;i<POND_DEPTH_SYSWORDS;++i){
+        tmcell->genome[i] = outputBuf[i];
+      }
+#endif
+      GENOME_CHANGED(tmcell);
+    } else {
+      DEBUG_VM("FAILED\n");
+    }
+  } else {
+    DEBUG_VM("NOT MODIFIED\n");
+  }
+
+  DEBUG_VM("** EXEC STOP\tiptr: %"PRIx64"\tmemptr: %"PRIx64"\n", VM_IPOS, VM_IPOS);
+  DEBUG_VM("** EXEC STOP\treg: %"PRIx64"\tfacing: %"PRIu64"\tenergy: %"PRIu64"\n", reg, facing, cell->energy);
+  VM_TRACE_EVENT(PONDTRACE_END, 0, VM_IPOS, VM_GETPOS(ptr_wordPtr, ptr_shiftPtr), executed);
+  return executed;
+#undef VM_TRACE_INST
+#undef VM_RESUMED
+#undef VM_RUN_BLOCK
+#undef VM_SETIP
+#undef VM_IPOS
+}
+
+#ifdef VM_TRACE
+/**
+ * Hashes a genome (FNV-1a over its words)
+ *
+ * @param genome Genome to hash
+ * @return Hash
+ */
+static inline uint64_t genotypeHash(const genome_t *const genome)
+{
+  uint64_t i, h = UINT64_C(1469598103934665603);
+
+  for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+    h = (h ^ genome[i]) * UINT64_C(1099511628211);
+  }
+  return h;
+}
+
+/**
+ * Decides whether an execution is one of those selected by pondTrace()
+ *
+ * @param vm VM context of the calling thread
+ * @param cell Cell about to be executed
+ * @return Nonzero to trace the execution
+ */
+static inline int traceSelected(struct VMContext *const vm, struct Cell *const cell)
+{
+  const struct PondTrace *const trace = &vm->pond->trace;
+
+  if ((trace->every)&&(!--vm->traceCountdown)) {
+    vm->traceCountdown = trace->every;
+    return 1;
+  }
+  if ((uint64_t)(cell - vm->pond->cells) == trace->cell) {
+    return 1;
+  }
+  return ((trace->genotype != PONDTRACE_NONE)&&(genotypeHash(cell->genome) == trace->genotype));
+}
+
+/**
+ * Executes a cell and records what it does, see runCell(). This is
+ * kept out of line so that execCell() stays as small as without
+ * VM_TRACE.
+ *
+ * @param vm Virtual machine scratch state of the calling thread
+ * @param cell Cell to execute
+ * @return Number of instructions executed (energy burned)
+ */
+static __attribute__((noinline)) uint64_t execCellTraced(struct VMContext *const vm, struct Cell *const cell)
+{
+  return runCell(vm, cell, 1);
+}
+
+/**
+ * Executes a cell, traced if it is selected for tracing, see runCell().
+ * Picks of cells without energy run nothing and are not counted.
+ *
+ * @param vm Virtual machine scratch state of the calling thread
+ * @param cell Cell to execute
+ * @return Number of instructions executed (energy burned)
+ */
+static inline uint64_t execCell(struct VMContext *const vm, struct Cell *const cell)
+{
+  if ((vm->pond->tracing)&&(cell->energy)&&(traceSelected(vm, cell))) {
+    return execCellTraced(vm, cell);
+  }
+  return runCell(vm, cell, 0);
+}
+#endif /* VM_TRACE */
+
+/**
+ * Resets a VM context to its state at startup
+ *
+ * @param pond Pond the context executes cells of
+ * @param vm Context to reset
+ */
+static void initVMContext(struct Pond *const pond, struct VMContext *const vm)
+{
+  uint64_t i;
+
+  vm->pond = pond;
+  for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+    vm->outputBuf[i] = ~((genome_t)0);
+  }
+#ifdef BUF_DIRTY_WORDS
+  for(i=0;i<BUF_DIRTY_SIZE;++i) {
+    vm->bufDirty[i] = 0;
+  }
+#endif
+#ifdef CYCLE_DETECTION
+  memset(vm->cycles, 0, sizeof(vm->cycles));
+  vm->cycleEffects = 0;
+#endif
+  vm->flags = 0;
+  vm->picks = 0;
+#ifdef CODE_CACHE
+  vm->codeEpoch = 0;
+#endif
+#ifdef LOOP_MATCH_TABLE
+  memset(vm->loopMatch, 0, sizeof(vm->loopMatch));
+#endif /* LOOP_MATCH_TABLE */
+#ifdef VM_BLOCKS
+  memset(vm->blocks, 0, sizeof(vm->blocks));
+  vm->blockOpsUsed = 0;
+#endif /* VM_BLOCKS */
+#ifdef TRACE_CACHE
+  if (vm->traces) {
+    memset(vm->traces, 0, TRACE_CACHE_SIZE * sizeof(struct Trace));
+  }
+#endif
+#if defined(LOOP_MATCH_TABLE)||defined(MUTATION_COUNTDOWN)
+  vm->mutationCountdown = mutationDistance();
+#endif
+}
+
+/**
+ * Clears a band of rows of the pond and initializes their genomes to
+ * 0xffff... The first write to a page of the pond decides where it is
+ * placed in memory, see initPond() in nanopond-parallel.h.
+ *
+ * @param pond Pond to clear
+ * @param y0 First row
+ * @param y1 End of the band (exclusive)
+ */
+static void clearPondRows(struct Pond *const pond, const uint64_t y0, const uint64_t y1)
+{
+  struct Cell *const cells = pond->cells;
+  uint64_t x, y, p, i;
+
+  for(y=y0;y<y1;++y) {
+    for(x=0;x<POND_SIZE_X;++x) {
+      p = y*(uint64_t)POND_SIZE_X+x;
+      cells[p].ID = 0;
+      cells[p].parentID = 0;
+      cells[p].lineage = 0;
+      cells[p].generation = 0;
+      cells[p].energy = 0;
+#ifdef ACTIVE_CELL_SET
+      pond->activeSlot[p] = NOT_ACTIVE;
+#endif
+      for(i=0;i<POND_DEPTH_SYSWORDS;++i){
+        cells[p].genome[i] = ~((genome_t)0);
+      }
+      GENOME_CHANGED(&cells[p]);
+
+      /* Space is toroidal; it wraps at edges */
+      cells[p].lw = (x) ? &POND(pond, x-1, y) : &POND(pond, POND_SIZE_X-1, y);
+      cells[p].re = (x < (POND_SIZE_X-1)) ? &POND(pond, x+1, y) : &POND(pond, 0, y);
+      cells[p].un = (y) ? &POND(pond, x, y-1) : &POND(pond, x, POND_SIZE_Y-1);
+      cells[p].ds = (y < (POND_SIZE_Y-1)) ? &POND(pond, x, y+1) : &POND(pond, x, 0);
+    }
+  }
+}
+
+#if defined(PICK_PIPELINE) && !defined(PARALLEL_EXEC)
+/**
+ * Draws a cell from the pick stream and starts loading the cache lines
+ * that tell whether it is alive and where its neighbors are.
+ *
+ * @param pond Pond to pick from
+ * @param ring Pick ring of the pond
+ * @return Picked cell
+ */
+static inline struct Cell *drawPick(struct Pond *const pond, struct PickRing *const ring)
+{
+  uint64_t s1 = ring->state[0];
+  const uint64_t s0 = ring->state[1];
+  struct Cell *cell;
+
+  ring->state[0] = s0;
+  s1 ^= s1 << 23;
+  ring->state[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+  cell = &pond->cells[(ring->state[1] + s0) % POND_SIZE];
+
+  __builtin_prefetch(&cell->energy);
+  __builtin_prefetch(&cell->lw);
+  return cell;
+}
+
+/**
+ * Seeds the pick stream from the pond's seed and fills the ring
+ *
+ * @param pond Pond to pick from
+ */
+static void initPickRing(struct Pond *const pond)
+{
+  struct PickRing *const ring = &pond->picks;
+  uint64_t key = pond->seed ^ UINT64_C(0x6a09e667f3bcc909);
+  uint64_t i;
+
+  ring->state[0] = splitmix64(&key);
+  ring->state[1] = splitmix64(&key);
+  for(i=0;i<PICK_PIPELINE;++i) {
+    ring->cells[i] = drawPick(pond, ring);
+  }
+  ring->pos = 0;
+}
+
+/**
+ * Takes the next cell to execute and moves the pipeline along. The
+ * pick half way down the ring has had time to load its energy and
+ * neighbor pointers, so if it is alive its genome and neighbors are
+ * prefetched too; empty cells never run and need nothing more.
+ *
+ * @param pond Pond to pick from
+ * @return Cell to execute now
+ */
+static inline struct Cell *nextPick(struct Pond *const pond)
+{
+  struct PickRing *const ring = &pond->picks;
+  struct Cell *const cell = ring->cells[ring->pos];
+  struct Cell *const ahead = ring->cells[(ring->pos + PICK_PIPELINE / 2) & (PICK_PIPELINE - 1)];
+  uint64_t i;
+
+  if (ahead->energy) {
+    for(i=0;i<sizeof(ahead->genome);i+=64) {
+      __builtin_prefetch((const uint8_t *)ahead->genome + i);
+    }
+    __builtin_prefetch(&ahead->lw->energy);
+    __builtin_prefetch(&ahead->re->energy);
+    __builtin_prefetch(&ahead->un->energy);
+    __builtin_prefetch(&ahead->ds->energy);
+  }
+
+  ring->cells[ring->pos] = drawPick(pond, ring);
+  ring->pos = (ring->pos + 1) & (PICK_PIPELINE - 1);
+  return cell;
+}
+#endif /* PICK_PIPELINE && !PARALLEL_EXEC */
+
+#ifdef PARALLEL_EXEC
+#include "nanopond-parallel.h"
+#endif /* PARALLEL_EXEC */
+
+#ifdef USE_SDL
+/* Window the pond is drawn in */
+static SDL_Surface *sdlScreen;
+
+/**
+ * Redraws a cell and its neighbors after they may have changed
+ *
+ * @param pond Pond on the screen
+ * @param idx Index of the cell in the pond
+ */
+static void drawNeighborhood(struct Pond *const pond, const uint64_t idx)
+{
+  SDL_Surface *const screen = sdlScreen;
+  const uint64_t sdlPitch = screen->pitch;
+  const uint64_t x = idx % POND_SIZE_X;
+  const uint64_t y = idx / POND_SIZE_X;
+
+  if (SDL_MUSTLOCK(screen)){
+    SDL_LockSurface(screen);
+  }
+  ((uint8_t *)screen->pixels)[x + (y * sdlPitch)] = getColor(&pond->cells[idx]);
+  if (x) {
+    ((uint8_t *)screen->pixels)[(x-1) + (y * sdlPitch)] = getColor(&POND(pond, x-1, y));
+    if (x < (POND_SIZE_X-1)) {
+      ((uint8_t *)screen->pixels)[(x+1) + (y * sdlPitch)] = getColor(&POND(pond, x+1, y));
+    } else {
+      ((uint8_t *)screen->pixels)[y * sdlPitch] = getColor(&POND(pond, 0, y));
+    }
+  } else {
+    ((uint8_t *)screen->pixels)[(POND_SIZE_X-1) + (y * sdlPitch)] = getColor(&POND(pond, POND_SIZE_X-1, y));
+    ((uint8_t *)screen->pixels)[1 + (y * sdlPitch)] = getColor(&POND(pond, 1, y));
+  }
+  if (y) {
+    ((uint8_t *)screen->pixels)[x + ((y-1) * sdlPitch)] = getColor(&POND(pond, x, y-1));
+    if (y < (POND_SIZE_Y-1)){
+      ((uint8_t *)screen->pixels)[x + ((y+1) * sdlPitch)] = getColor(&POND(pond, x, y+1));
+    } else {
+      ((uint8_t *)screen->pixels)[x] = getColor(&POND(pond, x, 0));
+    }
+  } else {
+      ((uint8_t *)screen->pixels)[x + ((POND_SIZE_Y-1) * sdlPitch)] = getColor(&POND(pond, x, POND_SIZE_Y-1));
+      ((uint8_t *)screen->pixels)[x + sdlPitch] = getColor(&POND(pond, x, 1));
+  }
+  if (SDL_MUSTLOCK(screen)){
+    SDL_UnlockSurface(screen);
+  }
+}
+#endif /* USE_SDL */
+
+#ifndef PARALLEL_EXEC
+/**
+ * Introduces a random cell somewhere in the pond (the parallel modes
+ * pace inflow themselves)
+ *
+ * @param pond Pond to seed
+ */
+static void inflowRandom(struct Pond *const pond)
+{
+  const uint64_t idx = getRandom() % POND_SIZE;
+
+  inflow(pond, &pond->cells[idx]);
+#ifdef USE_SDL
+  /* Update the random cell on SDL screen if viz is enabled */
+  if (SDL_MUSTLOCK(sdlScreen)){
+    SDL_LockSurface(sdlScreen);
+  }
+  ((uint8_t *)sdlScreen->pixels)[(idx % POND_SIZE_X) + ((idx / POND_SIZE_X) * sdlScreen->pitch)] = getColor(&pond->cells[idx]);
+  if (SDL_MUSTLOCK(sdlScreen)){
+    SDL_UnlockSurface(sdlScreen);
+  }
+#endif /* USE_SDL */
+}
+#endif /* !PARALLEL_EXEC */
+
+/**
+ * Creates a pond with all cells empty. The pond gets a random number
+ * stream of its own from the seed, so two ponds created with the same
+ * seed and stepped the same way end up the same (in the serial loop).
+ *
+ * @param seed Random number seed
+ * @return New pond, or 0 if it could not be allocated
+ */
+struct Pond *pondCreate(const uint64_t seed)
+{
+  struct Pond *pond;
+  uint64_t i;
+
+  pond = aligned_alloc(4096, (sizeof(struct Pond) + 4095) & ~(size_t)4095);
+  if (!pond) {
+    return 0;
+  }
+  /* Everything but the cells starts out zero; the cells are set up
+  * below, which places their pages (see struct Pond) */
+  memset(pond, 0, offsetof(struct Pond, cells));
+  pond->seed = seed;
+
+  /* Seed and init the random number generator */
+  init_genrand(seed, 0);
+  for(i=0;i<1024;++i){
+    getRandom();
+  }
+
+  /* Clear the pond and initialize all genomes to 0xffff... */
+#ifdef PARALLEL_EXEC
+  initPond(pond);
+#else
+  clearPondRows(pond, 0, POND_SIZE_Y);
+
+  /* Virtual machine state of the (only) thread */
+  initVMContext(pond, &pond->vm[0]);
+#ifdef PICK_PIPELINE
+  initPickRing(pond);
+#endif /* PICK_PIPELINE */
+#endif /* PARALLEL_EXEC */
+
+  save_xorgen(&pond->random);
+  return pond;
+}
+
+/**
+ * Frees a pond and everything its VM contexts allocated
+ *
+ * @param pond Pond to free
+ */
+void pondDestroy(struct Pond *const pond)
+{
+#if defined(VM_JIT) || defined(TRACE_CACHE)
+  uint64_t t;
+
+  for(t=0;t<VM_CONTEXTS;++t) {
+#ifdef VM_JIT
+    jitRelease(&pond->vm[t]);
+#endif
+#ifdef TRACE_CACHE
+    free(pond->vm[t].traces);
+#endif
+  }
+#endif /* VM_JIT || TRACE_CACHE */
+  free(pond);
+}
+
+/**
+ * Runs a pond for a number of clock ticks. Each tick executes a cell
+ * picked at random, and every INFLOW_FREQUENCY'th tick first puts a
+ * random cell somewhere. The parallel modes only run whole rounds, so
+ * they may run past the ticks asked for.
+ *
+ * @param pond Pond to run
+ * @param ticks Number of clock ticks to run
+ * @return Clock value after the last tick run
+ */
+uint64_t pondStep(struct Pond *const pond, const uint64_t ticks)
+{
+  const uint64_t end = pond->clock + ticks;
+#ifndef PARALLEL_EXEC
+  struct VMContext *const vm = &pond->vm[0];
+  uint64_t clock = pond->clock, batchEnd = 0;
+  struct Cell *cell = 0;
+#ifdef ACTIVE_CELL_SET
+  uint64_t skip;
+#endif
+#endif /* !PARALLEL_EXEC */
+
+  /* The pond's own random number stream runs on this thread meanwhile */
+  load_xorgen(&pond->random);
+
+#ifdef PARALLEL_EXEC
+  while (pond->clock < end) {
+    pond->clock += runParallelRound(pond, pond->clock);
+  }
+#else
+  while (clock < end) {
+    /* Clock is incremented at the start, so it starts at 1 */
+    ++clock;
+    if (!(clock % INFLOW_FREQUENCY)) {
+      inflowRandom(pond);
+    }
+    batchEnd = (clock / INFLOW_FREQUENCY + 1) * INFLOW_FREQUENCY;
+    if (batchEnd > end + 1) {
+      batchEnd = end + 1;
+    }
+
+    /* Then run one pick per tick up to the tick before the next inflow */
+    for(;;) {
+      /* Pick a random cell to execute */
+#if defined(ACTIVE_CELL_SET)
+      /* Picks of cells without energy do nothing, so jump straight to
+      * the next live pick, drawn uniformly from the live cells. If it
+      * would come at or after the next inflow, run the clock up to
+      * that tick instead and draw again from there; picks have no
+      * memory, so this does not change the odds. */
+      skip = emptyPicks(pond);
+      if ((!pond->activeCount)||(skip >= batchEnd - clock)) {
+        clock = batchEnd - 1;
+        break;
+      }
+      clock += skip;
+      cell = &pond->cells[pond->activeCells[getRandom() % pond->activeCount]];
+#elif defined(PICK_PIPELINE)
+      cell = nextPick(pond);
+#else
+      cell = &pond->cells[getRandom() % POND_SIZE];
+#endif /* PICK_PIPELINE */
+
+      execCell(vm, cell);
+
+#ifdef USE_SDL
+      /* Update the neighborhood on SDL screen to show any changes. */
+      drawNeighborhood(pond, cell - pond->cells);
+#endif /* USE_SDL */
+
+      if (clock + 1 >= batchEnd) {
+        break;
+      }
+      ++clock;
+    }
+  }
+  pond->clock = clock;
+#endif /* PARALLEL_EXEC */
+
+  save_xorgen(&pond->random);
+  return pond->clock;
+}
+
+/**
+ * Gets the number of clock ticks a pond has run
+ *
+ * @param pond Pond
+ * @return Clock value
+ */
+uint64_t pondClock(const struct Pond *const pond)
+{
+  return pond->clock;
+}
+
+/**
+ * Puts a new cell into a pond in place of whatever is at (x, y). It
+ * has no parent and starts a lineage of its own, like the random cells
+ * of inflow. Positions wrap around at the edges.
+ *
+ * @param pond Pond to put the cell into
+ * @param x X position
+ * @param y Y position
+ * @param genome POND_GENOME_WORDS words of genome
+ * @param energy Energy of the cell
+ */
+void pondInject(struct Pond *const pond, const uint64_t x, const uint64_t y, const uint64_t *const genome, const uint64_t energy)
+{
+  struct Cell *const cell = &POND(pond, x % POND_SIZE_X, y % POND_SIZE_Y);
+  uint64_t i;
+
+  /* No tick is running, so the ID is taken straight from the counter
+  * whichever way ticks hand them out */
+  cell->ID = pond->cellIdCounter++;
+  cell->parentID = 0;
+  cell->lineage = cell->ID;
+  cell->generation = 0;
+  cell->energy = energy;
+  for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+    cell->genome[i] = genome[i];
+  }
+  GENOME_CHANGED(cell);
+  ENERGY_CHANGED(pond, cell);
+}
+
+/**
+ * Copies cells out of a pond. Cells are numbered in row order, so
+ * cell (x, y) is number y * POND_SIZE_X + x.
+ *
+ * @param pond Pond to copy from
+ * @param first Number of the first cell to copy
+ * @param count Number of cells to copy
+ * @param cells Receives the cells
+ * @return Number of cells copied (fewer at the end of the pond)
+ */
+uint64_t pondSnapshot(const struct Pond *const pond, const uint64_t first, const uint64_t count, struct PondCell *const cells)
+{
+  uint64_t n, i;
+
+  if (first >= POND_SIZE) {
+    return 0;
+  }
+  n = (count < POND_SIZE - first) ? count : (POND_SIZE - first);
+  for(i=0;i<n;++i) {
+    const struct Cell *const c = &pond->cells[first + i];
+    cells[i].ID = c->ID;
+    cells[i].parentID = c->parentID;
+    cells[i].lineage = c->lineage;
+    cells[i].generation = c->generation;
+    cells[i].energy = c->energy;
+    memcpy(cells[i].genome, c->genome, sizeof(cells[i].genome));
+  }
+  return n;
+}
+
+#ifdef VM_TRACE
+/**
+ * Selects the executions of a pond to trace. This is meant to be
+ * called between steps; every counts executions on each VM context.
+ *
+ * @param pond Pond to trace
+ * @param trace Executions to trace, or 0 to stop tracing
+ */
+void pondTrace(struct Pond *const pond, const struct PondTrace *const trace)
+{
+  uint64_t t;
+
+  if (trace) {
+    pond->trace = *trace;
+    pond->tracing = (trace->every)||(trace->cell != PONDTRACE_NONE)||(trace->genotype != PONDTRACE_NONE);
+  } else {
+    pond->tracing = 0;
+  }
+  for(t=0;t<VM_CONTEXTS;++t) {
+    pond->vm[t].traceCountdown = pond->trace.every;
+  }
+}
+
+/**
+ * Takes events out of the trace rings of a pond. Events are copied
+ * out and then checked against how far the writer has got since, so
+ * that any it may have overwritten meanwhile are counted as lost
+ * rather than returned.
+ *
+ * @param pond Pond to take events from
+ * @param events Where to copy the events to
+ * @param count Room in events
+ * @return Number of events copied
+ */
+uint64_t pondTraceRead(struct Pond *const pond, struct PondTraceEvent *const events, const uint64_t count)
+{
+  uint64_t t, n = 0, head, tail, end, valid, lost;
+  struct VMContext *vm;
+  struct PondTraceEvent *batch;
+
+  for(t=0;(t<VM_CONTEXTS)&&(n + 1 < count);++t) {
+    vm = &pond->vm[t];
+    /* The slot of event head may be being written over event
+    * head - VM_TRACE, so that one counts as lost already */
+    head = __atomic_load_n(&vm->traceHead, __ATOMIC_ACQUIRE);
+    tail = (head - vm->traceTail >= VM_TRACE) ? (head - VM_TRACE + 1) : vm->traceTail;
+    if (tail == head) {
+      continue;
+    }
+    end = (head - tail < count - n - 1) ? head : (tail + (count - n - 1));
+
+    /* The context event goes first, then the events from tail to end */
+    batch = &events[n + 1];
+    for(valid=tail;valid<end;++valid) {
+      batch[valid - tail] = vm->traceRing[valid & (VM_TRACE - 1)];
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    head = __atomic_load_n(&vm->traceHead, __ATOMIC_ACQUIRE);
+    valid = (head - tail >= VM_TRACE) ? (head - VM_TRACE + 1) : tail;
+    if (valid >= end) {
+      /* All of them were overwritten while being copied, which the
+      * next call counts as lost */
+      continue;
+    }
+    if (valid > tail) {
+      memmove(batch, &batch[valid - tail], (end - valid) * sizeof(struct PondTraceEvent));
+    }
+    lost = valid - vm->traceTail;
+
+    memset(&events[n], 0, sizeof(struct PondTraceEvent));
+    events[n].kind = PONDTRACE_CONTEXT;
+    events[n].inst = (uint8_t)t;
+    events[n].value = lost;
+    n += 1 + (end - valid);
+    vm->traceTail = end;
+  }
+  return n;
+}
+
+/**
+ * Hashes a genome for selecting it in struct PondTrace
+ *
+ * @param genome POND_GENOME_WORDS words of genome
+ * @return Hash
+ */
+uint64_t pondGenotype(const uint64_t *const genome)
+{
+  return genotypeHash(genome);
+}
+#endif /* VM_TRACE */
+
+#ifndef NANOPOND_LIBRARY
+#ifdef USE_SDL
+/**
+ * Refreshes the screen and checks for input
+ *
+ * @param pond Pond on the screen
+ * @param clock Clock value
+ */
+static void refreshScreen(struct Pond *const pond, const uint64_t clock)
+{
+#ifdef PARALLEL_EXEC
+  /* The workers do not draw, so the whole pond is redrawn */
+  redrawScreen(pond, sdlScreen);
+#endif /* PARALLEL_EXEC */
+  pollSDL(pond, sdlScreen);
+}
+#endif /* USE_SDL */
+
+/**
+ * Prints the clock so progress can be followed
+ *
+ * @param pond Pond being run
+ * @param clock Clock value
+ */
+static void printProgress(struct Pond *const pond, const uint64_t clock)
+{
+  printf("%"PRIu64"\n", clock);
+}
+
+#ifdef VM_TRACE
+/* Clock ticks between writes of the trace file. A multiple of
+ * INFLOW_FREQUENCY, where the serial loop ends its batches anyway, so
+ * that writing it does not change how the pond evolves. */
+#define TRACE_WRITE_FREQUENCY (10 * INFLOW_FREQUENCY)
+
+/* File traced events are written to, if tracing was switched on */
+static FILE *traceFile = 0;
+
+/**
+ * Switches tracing on if any of these environment variables select
+ * executions to trace: NANOPOND_TRACE_EVERY (trace one in this many),
+ * NANOPOND_TRACE_CELL (every execution of the cell at "x,y") and
+ * NANOPOND_TRACE_GENOTYPE (every execution of a genome with this hash,
+ * in hexadecimal, see pondGenotype()). Events are written to the file
+ * named by NANOPOND_TRACE_FILE, or nanopond.trace, for tracedump.
+ *
+ * @param pond Pond to trace
+ */
+static void startTrace(struct Pond *const pond)
+{
+  struct PondTrace trace = { 0, PONDTRACE_NONE, PONDTRACE_NONE };
+  const char *v;
+  unsigned long long x, y;
+
+  if ((v = getenv("NANOPOND_TRACE_EVERY"))) {
+    trace.every = strtoull(v, 0, 10);
+  }
+  if ((v = getenv("NANOPOND_TRACE_CELL"))&&(sscanf(v, "%llu,%llu", &x, &y) == 2)) {
+    trace.cell = (uint64_t)((y % POND_SIZE_Y) * POND_SIZE_X + (x % POND_SIZE_X));
+  }
+  if ((v = getenv("NANOPOND_TRACE_GENOTYPE"))) {
+    trace.genotype = strtoull(v, 0, 16);
+  }
+  if ((!trace.every)&&(trace.cell == PONDTRACE_NONE)&&(trace.genotype == PONDTRACE_NONE)) {
+    return;
+  }
+  if (!(v = getenv("NANOPOND_TRACE_FILE"))) {
+    v = "nanopond.trace";
+  }
+  if (!(traceFile = fopen(v, "wb"))) {
+    fprintf(stderr, "*** Unable to open trace file %s ***\n", v);
+    exit(1);
+  }
+  pondTrace(pond, &trace);
+}
+
+/**
+ * Writes the events traced since the last write to the trace file
+ *
+ * @param pond Pond being traced
+ * @param clock Clock value
+ */
+static void writeTrace(struct Pond *const pond, const uint64_t clock)
+{
+  static struct PondTraceEvent events[VM_TRACE];
+  uint64_t n;
+
+  if (!traceFile) {
+    return;
+  }
+  while ((n = pondTraceRead(pond, events, VM_TRACE))) {
+    fwrite(events, sizeof(struct PondTraceEvent), n, traceFile);
+  }
+}
+#endif /* VM_TRACE */
+
+/**
+ * Something the main loop does every so many clock ticks
+ */
+struct PeriodicTask
+{
+  /* Clock ticks between two runs */
+  uint64_t period;
+
+  /* Clock tick of the next run */
+  uint64_t next;
+
+  /* Runs the task */
+  void (*run)(struct Pond *const pond, const uint64_t clock);
+};
+
+/* Periodic tasks, run in this order when several are due at the same
+ * tick, before the tick runs (and so before its inflow and pick). New
+ * periodic tasks go here. */
+static struct PeriodicTask periodicTasks[] = {
+#ifdef REPORT_FREQUENCY
+  { REPORT_FREQUENCY, REPORT_FREQUENCY, doReport },
+#endif
+#ifdef USE_SDL
+  { SDL_REFRESH_FREQUENCY, SDL_REFRESH_FREQUENCY, refreshScreen },
+#endif
+#ifdef DUMP_FREQUENCY
+  { DUMP_FREQUENCY, DUMP_FREQUENCY, doDump },
+#endif
+#ifdef VM_TRACE
+  { TRACE_WRITE_FREQUENCY, TRACE_WRITE_FREQUENCY, writeTrace },
+#endif
+  { 10000000, 10000000, printProgress },
+};
+#define NUM_PERIODIC_TASKS (sizeof(periodicTasks) / sizeof(struct PeriodicTask))
+
+/**
+ * Runs every periodic task that fell due at or before a clock tick.
+ * The parallel modes move the clock a round at a time, so there a
+ * task runs once at the end of the round in which it fell due.
+ *
+ * @param pond Pond being run
+ * @param clock Clock value
+ * @return Next clock tick at which a task is due
+ */
+static uint64_t runPeriodicTasks(struct Pond *const pond, const uint64_t clock)
+{
+  uint64_t i, next = UINT64_MAX;
+
+  for(i=0;i<NUM_PERIODIC_TASKS;++i) {
+    struct PeriodicTask *const t = &periodicTasks[i];
+    if (t->next <= clock) {
+      t->run(pond, clock);
+      t->next = (clock / t->period + 1) * t->period;
+    }
+    if (t->next < next) {
+      next = t->next;
+    }
+  }
+  return next;
+}
+
+/**
+ * Main method
+ *
+ * @param argc Number of args
+ * @param argv Argument array
+ */
+int main(int argc,char **argv)
+{
+  struct Pond *pond;
+
+  /* Create the pond, with its random number generator seeded */
+#ifdef RANDOM_NUMBER_SEED
+  pond = pondCreate(RANDOM_NUMBER_SEED);
+#else
+  pond = pondCreate(time(NULL));
+#endif
+  if (!pond) {
+    fprintf(stderr,"*** Unable to allocate the pond ***\n");
+    exit(1);
+  }
+#ifdef VM_TRACE
+  startTrace(pond);
+#endif
+
+  /* Set up SDL if we're using it */
+#ifdef USE_SDL
+  SDL_Surface *screen;
+  if (SDL_Init(SDL_INIT_VIDEO) < 0 ) {
+    fprintf(stderr,"*** Unable to init SDL: %s ***\n",SDL_GetError());
+    exit(1);
+  }
+  atexit(SDL_Quit);
+  SDL_WM_SetCaption("nanopond","nanopond");
+  screen = SDL_SetVideoMode(POND_SIZE_X,POND_SIZE_Y,8,SDL_SWSURFACE);
+  if (!screen) {
+    fprintf(stderr, "*** Unable to create SDL window: %s ***\n", SDL_GetError());
+    exit(1);
+  }
+  sdlScreen = screen;
+#endif /* USE_SDL */
+
+  /* Clock is incremented on each core loop */
+  uint64_t clock = 0;
+
+  printf("exec_start\n");
+  /* Main loop */
+  for(;;) {
+    /* Stop at STOP_AT if defined */
+#ifdef STOP_AT
+    if (clock >= STOP_AT) {
+    /* Also do a final dump if dumps are enabled */
+#ifdef DUMP_FREQUENCY
+      doDump(pond, clock);
+#endif /* DUMP_FREQUENCY */
+      fprintf(stderr,"[QUIT] STOP_AT clock value reached\n");
+      break;
+    }
+#endif /* STOP_AT */
+
+#ifdef PARALLEL_EXEC
+    /* Run a round of picks on all threads, then catch up with the
+    * periodic tasks whose clock values were passed in the round. */
+    clock = pondStep(pond, 1);
+    runPeriodicTasks(pond, clock);
+#else
+    /* Run the periodic tasks due at the next tick, then run the pond up
+    * to the tick before the next one is due */
+    uint64_t batchEnd = runPeriodicTasks(pond, clock + 1);
+#ifdef STOP_AT
+    if (batchEnd > STOP_AT + 1) {
+      batchEnd = STOP_AT + 1;
+    }
+#endif /* STOP_AT */
+    clock = pondStep(pond, batchEnd - 1 - clock);
+#endif /* PARALLEL_EXEC */
+  }
+
+#ifdef VM_TRACE
+  if (traceFile) {
+    writeTrace(pond, clock);
+    fclose(traceFile);
+  }
+#endif
+  pondDestroy(pond);
   exit(0);
   return 0; /* Make compiler shut up */
 }
+#endif /* !NANOPOND_LIBRARY */
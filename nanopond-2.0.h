@@ -1,10 +1,23 @@
+/* Needed for sched_setaffinity() and the CPU_* macros (NUMA_AWARE) */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1
+#endif
 #include <inttypes.h>
+#include <math.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
-#include "nanopond-params.h"
+#include "nanopond.h"
+#ifdef NANOPOND_LIBRARY
+/* The display, reports and dumps are left to the program using the
+ * library */
+#undef USE_SDL
+#undef REPORT_FREQUENCY
+#undef DUMP_FREQUENCY
+#endif /* NANOPOND_LIBRARY */
 #ifdef USE_SDL
 #ifdef _MSC_VER
 #include <SDL.h>
@@ -12,16 +25,70 @@
 #include <SDL/SDL.h>
 #endif /* _MSC_VER */
 #endif /* USE_SDL */
+#if defined(VM_BLOCKS) && !defined(MUTATION_COUNTDOWN)
+#error "VM_BLOCKS needs MUTATION_COUNTDOWN"
+#endif
+#if defined(TRACE_CACHE) && !defined(MUTATION_COUNTDOWN)
+#error "TRACE_CACHE needs MUTATION_COUNTDOWN"
+#endif
+#if defined(LOOP_IDIOMS) && !defined(MUTATION_COUNTDOWN)
+#error "LOOP_IDIOMS needs MUTATION_COUNTDOWN"
+#endif
+#if defined(CYCLE_DETECTION) && !defined(MUTATION_COUNTDOWN)
+#error "CYCLE_DETECTION needs MUTATION_COUNTDOWN"
+#endif
+#if defined(EXEC_QUANTUM) && (defined(VM_JIT) || defined(TRACE_CACHE))
+#error "VM_JIT and TRACE_CACHE take over the start of an execution, which EXEC_QUANTUM may resume instead"
+#endif
+#if defined(TRACE_CACHE) && defined(VM_JIT)
+#error "TRACE_CACHE and VM_JIT both take over the start of an execution, select only one"
+#endif
+#ifdef VM_TRACE
+#if (VM_TRACE < 2) || (VM_TRACE & (VM_TRACE - 1))
+#error "VM_TRACE must be a power of two of at least 2"
+#endif
+#if (POND_SIZE_X > 65536) || (POND_SIZE_Y > 65536) || (POND_DEPTH > 65536)
+#error "VM_TRACE records positions in 16 bits"
+#endif
+#endif /* VM_TRACE */
+/* Things derived from the running genome are kept (and forgotten when
+ * it changes) with either of these */
+#if defined(LOOP_MATCH_TABLE) || defined(VM_BLOCKS)
+#define CODE_CACHE 1
+#endif
 #include "nanopond-vminst.h"
 
-#include "xorshift/xorshift.h"
-static void init_genrand() {
-#ifdef RANDOM_NUMBER_SEED
- unsigned long s = (RANDOM_NUMBER_SEED);
+#ifdef _OPENMP
+#include <omp.h>
 #else
- unsigned long s = time(NULL);
+#define omp_get_thread_num() 0
+#define omp_get_num_threads() 1
+#endif
+
+#if (defined(PARALLEL_TILES) + defined(PARALLEL_RANDOM) + defined(PARALLEL_SPECULATIVE)) > 1
+#error "Select only one parallel execution mode"
+#endif
+#if defined(PARALLEL_TILES) || defined(PARALLEL_RANDOM) || defined(PARALLEL_SPECULATIVE)
+#define PARALLEL_EXEC 1
+#endif
+
+#if defined(NANOPOND_LIBRARY) && defined(PARALLEL_EXEC)
+#error "The parallel modes share their worker threads and scheduling between ponds, so the library only runs the serial loop"
+#endif
+
+#ifdef RANDOM_LANES
+#if (RANDOM_LANES != 4) && (RANDOM_LANES != 8)
+#error "RANDOM_LANES must be 4 or 8"
+#endif
+#define XLANES RANDOM_LANES
 #endif
-  init_xorgen(s);
+#include "xorshift/xorshift.h"
+
+/* Each thread owns its own generator state; stream 0 is the main
+ * thread and workers use 1..NUM_THREADS. A pond keeps the state of
+ * its main thread stream while it is not running (see pondStep()). */
+static void init_genrand(const uint64_t seed, const uint64_t stream) {
+  init_xorgen(seed + stream * UINT64_C(0x9e3779b97f4a7c15));
 }
 static inline uint64_t getRandom()
 {
@@ -43,12 +110,71 @@ static inline uint64_t getRandom()
 #define STATCOUNTER(...)
 #endif
 
+/* Per-report statistics are counted by each VM context on its own
+ * and added up by doReport(), so threads never share them. Only
+ * usable where a VM context called vm is in scope. */
+#define STAT_INC(stat) (++(vm->stats.stat))
+
+/* Called wherever a cell's energy may have gone from zero to nonzero
+ * or back, to keep the set of live cells up to date */
+#if defined(EXEC_QUANTUM) && defined(PARALLEL_EXEC)
+#error "EXEC_QUANTUM only works with the serial loop"
+#endif
+
+#ifdef ACTIVE_CELL_SET
+#if defined(PARALLEL_EXEC) || defined(PICK_PIPELINE)
+#error "ACTIVE_CELL_SET only works with the serial loop and without PICK_PIPELINE"
+#endif
+#define ENERGY_CHANGED(p, c) syncActive(p, c)
+#else
+#define ENERGY_CHANGED(p, c)
+#endif /* ACTIVE_CELL_SET */
+
+/* Called wherever a cell's genome changes, so that the compiled code
+ * the cell last ran is looked up again (see jitFind()) */
+#ifdef VM_JIT
+#define JIT_FORGET(c) ((c)->jitEntry = 0, (c)->jitTag = 0)
+#else
+#define JIT_FORGET(c) ((void)0)
+#endif /* VM_JIT */
+
+/* Called wherever a cell's genome is replaced by something other than
+ * its own WRITEG and XCHG (which update both copies), so that the
+ * decoded copy is made again from the new genome */
+#ifdef GENOME_DECODE
+#define GENOME_CHANGED(c) ((c)->decoded = 0, JIT_FORGET(c))
+#else
+#define GENOME_CHANGED(c) JIT_FORGET(c)
+#endif /* GENOME_DECODE */
+
+#if defined(PARALLEL_SPECULATIVE)
+/* A tick that has not been committed yet hands out placeholder IDs,
+ * numbered from zero within the tick and tagged with the top bit. They
+ * are turned into real IDs in clock order when the tick commits. */
+#define SPEC_ID_TAG (UINT64_C(1) << 63)
+#define CELL_ID_POSTINC(p) (SPEC_ID_TAG | specIdCount++)
+#define CELL_ID_PREINC(p) (SPEC_ID_TAG | ++specIdCount)
+#elif defined(PARALLEL_EXEC)
+/* Every thread hands out IDs from its own block of the counter, see
+ * takeCellId(). Both variants take a fresh ID so IDs stay unique. */
+#define CELL_ID_POSTINC(p) takeCellId(p)
+#define CELL_ID_PREINC(p) takeCellId(p)
+#else
+#define CELL_ID_POSTINC(p) ((p)->cellIdCounter++)
+#define CELL_ID_PREINC(p) (++(p)->cellIdCounter)
+#endif
+
 /* Pond depth in machine-size words.  This is calculated from
  * POND_DEPTH and the size of the machine word. (The multiplication
  * by two is due to the fact that there are two four-bit values in
  * each eight-bit byte.) */
 #define POND_DEPTH_SYSWORDS (POND_DEPTH / (sizeof(uint64_t) * 2))
 
+#ifdef BUF_DIRTY_WORDS
+/* Words of the bitmap of output buffer words written to */
+#define BUF_DIRTY_SIZE ((POND_DEPTH_SYSWORDS + 63) / 64)
+#endif
+
 /* Number of bits in a machine-size word */
 #define SYSWORD_BITS (sizeof(uint64_t) * 8)
 
@@ -94,15 +220,38 @@ struct Cell
   /* Energy level of this cell */
   uint64_t energy;
 
+#ifdef PARALLEL_RANDOM
+  /* Nonzero while a worker thread holds this cell (kept next to the
+  * energy so both share a cache line) */
+  uint64_t claimed;
+#endif
+
+#ifdef VM_JIT
+  /* Entry of the JIT cache the genome was last found in, and the
+  * entry's tag at the time, which changes when the entry is given
+  * to another genome (no entry and a tag of 0 until the genome has
+  * run once) */
+  struct JitEntry *jitEntry;
+  uint64_t jitTag;
+#endif
+
+#ifdef GENOME_DECODE
+  /* The genome unpacked into one codon per byte, a word at a time as
+  * it is run, with a bit for each word that is. Kept next to the
+  * energy, so that a short execution touches little more than the
+  * cache line that holds both. */
+  uint64_t decoded;
+  uint8_t code[POND_DEPTH];
+#endif
+
   /* Memory space for cell genome (genome is stored as four
   * bit instructions packed into machine size words) */
   genome_t genome[POND_DEPTH_SYSWORDS];
   struct Cell *un, *ds, *re, *lw;
 };
 
-/* The pond is a 2D array of cells */
-struct Cell pond[(uint64_t)POND_SIZE_X*(uint64_t)POND_SIZE_Y];
-#define POND(x, y) pond[((uint64_t)y)*(uint64_t)POND_SIZE_X+((uint64_t)x)]
+/* The cells of a pond are a 2D array */
+#define POND(p, x, y) (p)->cells[((uint64_t)y)*(uint64_t)POND_SIZE_X+((uint64_t)x)]
 #define POND_SIZE ((uint64_t)POND_SIZE_X * (uint64_t)POND_SIZE_Y)
 
 /* Currently selected color scheme */
@@ -129,7 +278,330 @@ struct PerReportStatCounters
 
   /* Number of successful SHARE operations */
   uint64_t viableCellShares;
+
+#ifdef TRACE_CACHE
+  /* Executions looked up in the trace cache, and those replayed */
+  uint64_t traceLookups;
+  uint64_t traceHits;
+#endif
+};
+
+#ifdef LOOP_MATCH_TABLE
+/* Where the REP matching a LOOP is, valid while epoch matches the
+ * context's codeEpoch */
+struct LoopMatch
+{
+  uint32_t epoch;
+  /* Codons fetched after the LOOP up to and including the REP, or 0
+  * if the LOOP never ends */
+  uint16_t length;
+  /* Position of the REP */
+  uint16_t end;
 };
+#endif /* LOOP_MATCH_TABLE */
 
-/* Global statistics counters */
-struct PerReportStatCounters statCounters;
+#ifdef VM_BLOCKS
+/* A run of codons that execute straight through, compiled to block
+ * operations, valid while epoch matches the context's codeEpoch */
+struct Block
+{
+  uint32_t epoch;
+  /* Its operations are blockOps[first] to blockOps[first + ops - 1]
+   * (there are up to twice POND_DEPTH of them) */
+  uint32_t first;
+  /* Codons in the block, or 0 if there is no block worth running */
+  uint16_t length;
+  uint16_t ops;
+  /* Set until the block is compiled, on the second visit */
+  uint16_t visited;
+};
+
+/* A block operation is the instruction it stands for, with a run of
+ * FWD and BACK turned into FWD by arg codons (modulo POND_DEPTH), a
+ * run of INC and DEC into INC by arg, and repeats of the others into
+ * one. */
+struct BlockOp
+{
+  uint16_t inst;
+  uint16_t arg;
+};
+
+/* Room for block operations in each context */
+#define BLOCK_OPS (POND_DEPTH * 2)
+#endif /* VM_BLOCKS */
+
+#ifdef EXEC_QUANTUM
+/* Executions that can be parked at once (a power of two). Cells share
+ * slots by position in the pond, and parking one drops another. */
+#define PARK_SLOTS 4096
+
+/* State of an execution parked when its quantum ran out */
+struct ParkedExec
+{
+  /* ID of the cell it belongs to then; a cell killed or replaced since
+  * has another */
+  uint64_t ID;
+  uint64_t falseLoopDepth;
+  uint16_t reg, ptr, facing, flags, ip, loopStackPtr;
+  /* Loop stack as codon positions */
+  uint16_t loopStack[POND_DEPTH];
+  /* Output buffer, if it was written to */
+  genome_t outputBuf[POND_DEPTH_SYSWORDS];
+};
+#endif /* EXEC_QUANTUM */
+
+#ifdef CYCLE_DETECTION
+/* REPs whose last jump back each context remembers (a power of two) */
+#define CYCLE_SLOTS 16
+
+/* State of the VM the last time a REP jumped back. Only the state
+ * that can change without a write (see VM_CYCLE_EFFECT) is kept. */
+struct CycleState
+{
+  /* Writes (and other effects) counted in the context up to then */
+  uint64_t effects;
+  /* Codons executed and left until the next mutation then */
+  uint64_t executed;
+  uint64_t countdown;
+  uint16_t rep, reg, ptr, facing, flags, loopStackPtr;
+};
+#endif /* CYCLE_DETECTION */
+
+#ifdef TRACE_CACHE
+/* Genomes whose traces each context remembers (a power of two) */
+#define TRACE_CACHE_SIZE 1024
+
+/* Executions of a genome before its trace is recorded */
+#define TRACE_THRESHOLD 2
+
+/* Deepest loop stack a trace can end with */
+#define TRACE_STACK 32
+
+/* What executing a genome from the start does up to the first step
+ * that depends on anything other than the genome (see recordTrace()).
+ * Traces are found by the first word of the genome, and a trace holds
+ * for any genome that has the same words where it read the genome. */
+struct Trace
+{
+  /* Genome the trace was recorded for, and a bit for each word of it
+  * that was read (the first word always is) */
+  genome_t genome[POND_DEPTH_SYSWORDS];
+  uint64_t read;
+
+  /* Executions of the genome so far, worn down by others that land on
+  * the same entry until one of them takes it over */
+  uint64_t runs;
+
+  /* Codons fetched, or 0 if the trace is not recorded yet */
+  uint64_t codons;
+
+  /* Set if the trace ends on a step that depends on more than the
+  * genome, rather than where the cell recording it had to stop */
+  uint64_t complete;
+
+  /* VM state at the end, with the memory pointer, the instruction
+  * pointer and the loop stack as codon positions */
+  uint32_t falseLoopDepth;
+  uint16_t reg, ptr, facing, flags, ip, stop, loopStackPtr;
+  uint16_t loopStack[TRACE_STACK];
+
+  /* Codons written to the output buffer (all bits of each set) and
+  * their values */
+  genome_t bufWritten[POND_DEPTH_SYSWORDS];
+  genome_t buf[POND_DEPTH_SYSWORDS];
+};
+#endif /* TRACE_CACHE */
+
+/**
+ * Scratch state of the virtual machine. Every thread that executes
+ * cells owns one of these.
+ */
+struct VMContext
+{
+  /* Pond whose cells the context executes */
+  struct Pond *pond;
+
+  /* Buffer used for execution output of candidate offspring */
+  genome_t outputBuf[POND_DEPTH_SYSWORDS];
+
+#ifdef BUF_DIRTY_WORDS
+  /* Words of outputBuf written since it was last cleared, a bit each */
+  uint64_t bufDirty[BUF_DIRTY_SIZE];
+#endif
+
+  /* Virtual machine loop/rep stack (with GENOME_DECODE only the first
+  * one is used, holding decoded instruction pointers) */
+  uint64_t loopStack_wordPtr[POND_DEPTH];
+  uint64_t loopStack_shiftPtr[POND_DEPTH];
+
+#ifdef CODE_CACHE
+  /* Changes whenever the executing genome does (see forgetCode()) */
+  uint32_t codeEpoch;
+#endif
+
+#ifdef LOOP_MATCH_TABLE
+  /* Matches found for LOOPs of the executing genome so far */
+  struct LoopMatch loopMatch[POND_DEPTH];
+#endif /* LOOP_MATCH_TABLE */
+
+#ifdef VM_BLOCKS
+  /* Blocks of the executing genome by where they start */
+  struct Block blocks[POND_DEPTH];
+  struct BlockOp blockOps[BLOCK_OPS];
+  uint64_t blockOpsUsed;
+#endif /* VM_BLOCKS */
+
+#if defined(LOOP_MATCH_TABLE)||defined(MUTATION_COUNTDOWN)
+  /* Codons to fetch up to and including the next one that mutates,
+  * carried over from one cell to the next */
+  uint64_t mutationCountdown;
+#endif
+
+#ifdef VM_JIT
+  /* Genomes run by this context and their compiled code, allocated on
+  * first use (see nanopond-jit.h) */
+  struct JitCache *jit;
+#endif
+
+#ifdef TRACE_CACHE
+  /* Traces of genomes run by this context, by hash (TRACE_CACHE_SIZE
+  * of them, allocated on first use) */
+  struct Trace *traces;
+#endif
+
+#ifdef CYCLE_DETECTION
+  /* Last state at REPs that jumped back, by position, and the count
+  * of effects that tells states of earlier executions apart */
+  struct CycleState cycles[CYCLE_SLOTS];
+  uint64_t cycleEffects;
+#endif
+
+  /* Machine flags; FLAG_BUF is kept between executions so that the
+  * output buffer is only cleared after a cell has written to it. */
+  uint64_t flags;
+
+  /* Number of cells picked by this context, used to pace inflow */
+  uint64_t picks;
+
+  /* Statistics counted since the last report (see STAT_INC) */
+  struct PerReportStatCounters stats;
+
+#ifdef VM_TRACE
+  /* Events of traced executions, written only by the thread running
+  * the context (see traceEvent()), the number ever written and the
+  * number ever taken by pondTraceRead() */
+  struct PondTraceEvent traceRing[VM_TRACE];
+  uint64_t traceHead;
+  uint64_t traceTail;
+
+  /* Executions until the next one of every trace.every is traced */
+  uint64_t traceCountdown;
+#endif /* VM_TRACE */
+} __attribute__ ((aligned (64)));
+
+/* One VM context for each thread that executes cells */
+#ifdef PARALLEL_EXEC
+#define VM_CONTEXTS NUM_THREADS
+#else
+#define VM_CONTEXTS 1
+#endif
+
+#if defined(PICK_PIPELINE) && !defined(PARALLEL_EXEC)
+#if (PICK_PIPELINE < 2) || (PICK_PIPELINE & (PICK_PIPELINE - 1))
+#error "PICK_PIPELINE must be a power of two of at least 2"
+#endif
+
+/**
+ * Cells the serial loop will execute next, picked PICK_PIPELINE ticks
+ * ahead from a random stream of their own
+ */
+struct PickRing
+{
+  /* Upcoming picks; slot pos is the next one due */
+  struct Cell *cells[PICK_PIPELINE];
+  uint64_t pos;
+
+  /* State of the pick stream (xorshift128+) */
+  uint64_t state[2];
+};
+#endif /* PICK_PIPELINE && !PARALLEL_EXEC */
+
+/**
+ * A pond and everything that goes on in it. Nothing else changes as
+ * it runs, apart from the random number generator state of the threads
+ * running it, so ponds do not get in each other's way.
+ */
+struct Pond
+{
+  /* Clock ticks run so far */
+  uint64_t clock;
+
+  /* Seed the pond was created with */
+  uint64_t seed;
+
+  /* This is used to generate unique cell IDs */
+  uint64_t cellIdCounter;
+
+  /* State of the main thread's random number stream between steps */
+  struct xorgen_state random;
+
+  /* Virtual machine state of each thread that executes cells */
+  struct VMContext vm[VM_CONTEXTS];
+
+#if defined(PICK_PIPELINE) && !defined(PARALLEL_EXEC)
+  /* Upcoming picks of the serial loop */
+  struct PickRing picks;
+#endif
+
+#ifdef ACTIVE_CELL_SET
+  /* Indices of all cells with energy in no particular order, and the
+  * place of each cell in that list (or NOT_ACTIVE) */
+  uint32_t activeCells[POND_SIZE];
+  uint32_t activeSlot[POND_SIZE];
+  uint64_t activeCount;
+#endif /* ACTIVE_CELL_SET */
+
+#ifdef VM_TRACE
+  /* Executions to trace, and whether any are (see pondTrace()) */
+  struct PondTrace trace;
+  int tracing;
+#endif
+
+#ifdef EXEC_QUANTUM
+  /* Executions parked when their quantum ran out, by position of the
+  * cell in the pond, and the cells they belong to (0 for none). These
+  * are apart so that looking up the slot of every cell picked touches
+  * little memory. */
+  struct ParkedExec parked[PARK_SLOTS];
+  struct Cell *parkedCells[PARK_SLOTS];
+#endif
+
+  /* The cells come last, so clearing everything else leaves where
+  * their pages are placed to clearPondRows() (see initPond()) */
+  struct Cell cells[POND_SIZE];
+} __attribute__ ((aligned (64)));
+
+#ifdef PARALLEL_SPECULATIVE
+/* Number of IDs taken by the tick the calling thread is running */
+static _Thread_local uint64_t specIdCount = 0;
+#elif defined(PARALLEL_EXEC)
+/* Next ID and end of the block of IDs the calling thread reserved */
+static _Thread_local uint64_t threadIdNext = 0, threadIdEnd = 0;
+
+/**
+ * Takes a cell ID. Threads reserve CELL_ID_BLOCK IDs at a time from
+ * the pond's cellIdCounter, so IDs are unique and each thread's are
+ * increasing, while the shared counter is only touched once per block.
+ *
+ * @param pond Pond the ID is for
+ * @return New cell ID
+ */
+static inline uint64_t takeCellId(struct Pond *const pond)
+{
+  if (threadIdNext == threadIdEnd) {
+    threadIdNext = __atomic_fetch_add(&pond->cellIdCounter, CELL_ID_BLOCK, __ATOMIC_RELAXED);
+    threadIdEnd = threadIdNext + CELL_ID_BLOCK;
+  }
+  return threadIdNext++;
+}
+#endif
@@ -0,0 +1,985 @@
+/* Native code for the genomes that run most. This is included by
+ * nanopond-2.0.c when VM_JIT is defined in nanopond-params.h.
+ *
+ * Each VM context keeps a cache of genomes it has run, keyed by a hash
+ * of the codons up to the first STOP: cells of one lineage tend to
+ * share that part and differ in what follows it, which execution from
+ * the start never reaches without leaving compiled code first. Once a
+ * genome has been run JIT_THRESHOLD times it is compiled to x86-64 code that does exactly what the VM_* macros
+ * do, with the VM state in registers. The compiled code hands back to
+ * the interpreter (see execCell()) with the VM state as it is whenever
+ * something it does not do comes up: a codon about to mutate, the cell
+ * writing a new value into its own genome, or a false LOOP that cannot
+ * be skipped in one step. */
+
+#ifndef __x86_64__
+#error "VM_JIT needs an x86-64 machine"
+#endif
+#ifndef MUTATION_COUNTDOWN
+#error "VM_JIT needs MUTATION_COUNTDOWN"
+#endif
+#if (POND_DEPTH & (POND_DEPTH - 1))
+#error "VM_JIT needs POND_DEPTH to be a power of two"
+#endif
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Genomes remembered by each VM context (a power of two) */
+#define JIT_CACHE_SIZE 16384
+
+/* Runs of a genome before it is compiled */
+#define JIT_THRESHOLD 64
+
+/* Cells with less energy than this are always interpreted, since they
+ * cannot run long enough to make up for looking up their genome */
+#define JIT_MIN_ENERGY 64
+
+/* Memory for compiled code in each VM context. When it is full all
+ * code is thrown away and hot genomes are compiled again. */
+#define JIT_ARENA_SIZE (16 * 1024 * 1024)
+
+/* Most code a genome can compile to, with its table of entry points */
+#define JIT_MAX_CODE (POND_DEPTH * 256 + 4096)
+
+/* State of the VM while compiled code runs, and where it stopped */
+struct JitState
+{
+  uint64_t reg;
+  /* Memory pointer as a codon position */
+  uint64_t ptr;
+  uint64_t energy;
+  uint64_t countdown;
+  uint64_t lsp;
+  /* Codon position the interpreter picks up from */
+  uint64_t ip;
+  uint64_t facing;
+  uint64_t flags;
+  uint64_t falseLoopDepth;
+  uint64_t stop;
+  /* Nonzero if a codon of the genome was changed */
+  uint64_t wrote;
+  genome_t *genome;
+  genome_t *outputBuf;
+  /* Loop stack, holding codon positions */
+  uint64_t *loopStack;
+  struct VMContext *vm;
+  struct Cell *cell;
+};
+
+typedef void (*JitCode)(struct JitState *);
+
+/* A genome that has been run, and its code once it is hot */
+struct JitEntry
+{
+  uint64_t hash;
+  /* Codons up to and including the first STOP, and whether they have
+  * been copied (see JitCache) */
+  uint64_t length;
+  uint64_t kept;
+  uint64_t runs;
+  JitCode code;
+  /* Changed whenever the entry is given to another genome, so that
+  * cells still pointing at it look their genome up again */
+  uint64_t tag;
+};
+
+/* Labels of a genome being compiled: where each codon position, the
+ * way out before its fetch, and the common way out start, followed by
+ * labels within instructions */
+#define JIT_LABEL_POS(p) (p)
+#define JIT_LABEL_OUT(p) (POND_DEPTH + (p))
+#define JIT_LABEL_UNDO(p) (2 * POND_DEPTH + (p))
+#define JIT_LABEL_EXIT (3 * POND_DEPTH)
+#define JIT_LABELS (8 * POND_DEPTH)
+
+struct JitCache
+{
+  struct JitEntry entries[JIT_CACHE_SIZE];
+
+  /* The genome of each entry (the rest of it zero) once it has run
+  * twice, since most genomes never run again. Kept apart so that the
+  * entries fit in the cache. */
+  genome_t genomes[JIT_CACHE_SIZE][POND_DEPTH_SYSWORDS];
+
+  /* Memory for code and how much of it is used. It is only writable
+  * while a genome is being compiled, and only executable otherwise. */
+  uint8_t *arena;
+  uint64_t arenaUsed;
+
+  /* Compiler state: where code goes, label offsets and the jumps to
+  * them that still need to be filled in */
+  uint8_t *out;
+  uint8_t *start;
+  uint64_t labelCount;
+  int64_t labels[JIT_LABELS];
+  uint64_t fixupCount;
+  struct {
+    uint8_t *at;
+    uint64_t label;
+  } fixups[JIT_LABELS * 2];
+};
+
+/* x86-64 registers */
+#define JIT_RAX 0
+#define JIT_RCX 1
+#define JIT_RDX 2
+#define JIT_RBX 3
+#define JIT_RSP 4
+#define JIT_RBP 5
+#define JIT_RSI 6
+#define JIT_RDI 7
+#define JIT_R8 8
+#define JIT_R9 9
+#define JIT_R12 12
+#define JIT_R13 13
+#define JIT_R14 14
+#define JIT_R15 15
+
+/* Where the VM state lives in compiled code. The JitState is in rbx. */
+#define JIT_REG JIT_R12
+#define JIT_PTR JIT_R13
+#define JIT_ENERGY JIT_R14
+#define JIT_COUNTDOWN JIT_R15
+#define JIT_LSP JIT_RBP
+
+/* Condition codes */
+#define JIT_CC_B 0x2
+#define JIT_CC_AE 0x3
+#define JIT_CC_E 0x4
+#define JIT_CC_NE 0x5
+#define JIT_CC_BE 0x6
+
+/* Opcode extensions of group 1 (arithmetic with an immediate) */
+#define JIT_ADD 0
+#define JIT_OR 1
+#define JIT_AND 4
+#define JIT_SUB 5
+#define JIT_CMP 7
+
+#define JIT_FIELD(f) ((int32_t)offsetof(struct JitState, f))
+
+static inline void jitByte(struct JitCache *const jc, const uint8_t b)
+{
+  *(jc->out++) = b;
+}
+
+static inline void jitImm32(struct JitCache *const jc, const uint32_t v)
+{
+  memcpy(jc->out, &v, 4);
+  jc->out += 4;
+}
+
+static inline void jitImm64(struct JitCache *const jc, const uint64_t v)
+{
+  memcpy(jc->out, &v, 8);
+  jc->out += 8;
+}
+
+/* REX prefix for 64-bit operands, with the high bits of the registers */
+static inline void jitRex(struct JitCache *const jc, const int r, const int x, const int b)
+{
+  jitByte(jc, 0x48 | ((r >> 3) << 2) | ((x >> 3) << 1) | (b >> 3));
+}
+
+static inline void jitModRM(struct JitCache *const jc, const int mod, const int r, const int rm)
+{
+  jitByte(jc, (mod << 6) | ((r & 7) << 3) | (rm & 7));
+}
+
+/* Operand [rbx + disp32] */
+static inline void jitField(struct JitCache *const jc, const int r, const int32_t disp)
+{
+  jitModRM(jc, 2, r, JIT_RBX);
+  jitImm32(jc, (uint32_t)disp);
+}
+
+/* mov r, [rbx + disp] */
+static inline void jitLoad(struct JitCache *const jc, const int r, const int32_t disp)
+{
+  jitRex(jc, r, 0, JIT_RBX);
+  jitByte(jc, 0x8b);
+  jitField(jc, r, disp);
+}
+
+/* mov [rbx + disp], r */
+static inline void jitStore(struct JitCache *const jc, const int32_t disp, const int r)
+{
+  jitRex(jc, r, 0, JIT_RBX);
+  jitByte(jc, 0x89);
+  jitField(jc, r, disp);
+}
+
+/* mov qword [rbx + disp], imm */
+static inline void jitStoreImm(struct JitCache *const jc, const int32_t disp, const int32_t imm)
+{
+  jitRex(jc, 0, 0, JIT_RBX);
+  jitByte(jc, 0xc7);
+  jitField(jc, 0, disp);
+  jitImm32(jc, (uint32_t)imm);
+}
+
+/* or/and qword [rbx + disp], imm */
+static inline void jitFieldOp(struct JitCache *const jc, const int op, const int32_t disp, const int32_t imm)
+{
+  jitRex(jc, 0, 0, JIT_RBX);
+  jitByte(jc, 0x81);
+  jitField(jc, op, disp);
+  jitImm32(jc, (uint32_t)imm);
+}
+
+/* test qword [rbx + disp], imm */
+static inline void jitFieldTest(struct JitCache *const jc, const int32_t disp, const int32_t imm)
+{
+  jitRex(jc, 0, 0, JIT_RBX);
+  jitByte(jc, 0xf7);
+  jitField(jc, 0, disp);
+  jitImm32(jc, (uint32_t)imm);
+}
+
+/* add/or/and/sub/cmp r, imm */
+static inline void jitOpImm(struct JitCache *const jc, const int op, const int r, const int32_t imm)
+{
+  jitRex(jc, 0, 0, r);
+  if ((imm >= -128)&&(imm <= 127)) {
+    jitByte(jc, 0x83);
+    jitModRM(jc, 3, op, r);
+    jitByte(jc, (uint8_t)imm);
+  } else {
+    jitByte(jc, 0x81);
+    jitModRM(jc, 3, op, r);
+    jitImm32(jc, (uint32_t)imm);
+  }
+}
+
+/* Two register instruction with the given opcode: dst op= src */
+static inline void jitOpReg(struct JitCache *const jc, const uint8_t opcode, const int dst, const int src)
+{
+  jitRex(jc, src, 0, dst);
+  jitByte(jc, opcode);
+  jitModRM(jc, 3, src, dst);
+}
+#define JIT_OP_ADD 0x01
+#define JIT_OP_OR 0x09
+#define JIT_OP_AND 0x21
+#define JIT_OP_XOR 0x31
+#define JIT_OP_CMP 0x39
+#define JIT_OP_TEST 0x85
+#define JIT_OP_MOV 0x89
+
+/* mov r, imm (sign extended) */
+static inline void jitMovImm(struct JitCache *const jc, const int r, const int32_t imm)
+{
+  jitRex(jc, 0, 0, r);
+  jitByte(jc, 0xc7);
+  jitModRM(jc, 3, 0, r);
+  jitImm32(jc, (uint32_t)imm);
+}
+
+/* mov r, imm64 */
+static inline void jitMovImm64(struct JitCache *const jc, const int r, const uint64_t imm)
+{
+  jitRex(jc, 0, 0, r);
+  jitByte(jc, 0xb8 + (r & 7));
+  jitImm64(jc, imm);
+}
+
+/* inc/dec r */
+static inline void jitIncDec(struct JitCache *const jc, const int dec, const int r)
+{
+  jitRex(jc, 0, 0, r);
+  jitByte(jc, 0xff);
+  jitModRM(jc, 3, dec, r);
+}
+
+/* shl/shr r, cl */
+#define JIT_SHL 4
+#define JIT_SHR 5
+static inline void jitShiftCl(struct JitCache *const jc, const int op, const int r)
+{
+  jitRex(jc, 0, 0, r);
+  jitByte(jc, 0xd3);
+  jitModRM(jc, 3, op, r);
+}
+
+/* not r */
+static inline void jitNot(struct JitCache *const jc, const int r)
+{
+  jitRex(jc, 0, 0, r);
+  jitByte(jc, 0xf7);
+  jitModRM(jc, 3, 2, r);
+}
+
+/* movzx eax, byte [rdx + rsi] */
+static inline void jitLoadByte(struct JitCache *const jc)
+{
+  jitByte(jc, 0x0f);
+  jitByte(jc, 0xb6);
+  jitByte(jc, 0x04);
+  jitByte(jc, 0x32);
+}
+
+/* mov byte [rdx + rsi], al */
+static inline void jitStoreByte(struct JitCache *const jc)
+{
+  jitByte(jc, 0x88);
+  jitByte(jc, 0x04);
+  jitByte(jc, 0x32);
+}
+
+static inline void jitFixup(struct JitCache *const jc, const uint64_t label)
+{
+  jc->fixups[jc->fixupCount].at = jc->out;
+  jc->fixups[jc->fixupCount].label = label;
+  ++jc->fixupCount;
+  jitImm32(jc, 0);
+}
+
+/* jmp label */
+static inline void jitJmp(struct JitCache *const jc, const uint64_t label)
+{
+  jitByte(jc, 0xe9);
+  jitFixup(jc, label);
+}
+
+/* jcc label */
+static inline void jitJcc(struct JitCache *const jc, const int cc, const uint64_t label)
+{
+  jitByte(jc, 0x0f);
+  jitByte(jc, 0x80 + cc);
+  jitFixup(jc, label);
+}
+
+static inline uint64_t jitNewLabel(struct JitCache *const jc)
+{
+  return jc->labelCount++;
+}
+
+static inline void jitBind(struct JitCache *const jc, const uint64_t label)
+{
+  jc->labels[label] = jc->out - jc->start;
+}
+
+/* Leaves compiled code, to pick up again in the interpreter at ip */
+static inline void jitExitAt(struct JitCache *const jc, const uint64_t ip)
+{
+  jitStoreImm(jc, JIT_FIELD(ip), (int32_t)ip);
+  jitJmp(jc, JIT_LABEL_EXIT);
+}
+
+/* Points rdx at the byte of the genome or buffer in field holding
+ * codon ptr (at rsi) and cl at its shift within the byte */
+static inline void jitCodonAddress(struct JitCache *const jc, const int32_t field)
+{
+  jitLoad(jc, JIT_RDX, field);
+  jitOpReg(jc, JIT_OP_MOV, JIT_RSI, JIT_PTR);
+  jitRex(jc, 0, 0, JIT_RSI);
+  jitByte(jc, 0xd1); /* shr rsi, 1 */
+  jitModRM(jc, 3, JIT_SHR, JIT_RSI);
+  jitOpReg(jc, JIT_OP_MOV, JIT_RCX, JIT_PTR);
+  jitOpImm(jc, JIT_AND, JIT_RCX, 1);
+  jitRex(jc, 0, 0, JIT_RCX);
+  jitByte(jc, 0xc1); /* shl rcx, 2 */
+  jitModRM(jc, 3, JIT_SHL, JIT_RCX);
+  jitByte(jc, 2);
+}
+
+/* Reads the codon at ptr of field into the register */
+static inline void jitReadCodon(struct JitCache *const jc, const int32_t field)
+{
+  jitCodonAddress(jc, field);
+  jitLoadByte(jc);
+  jitShiftCl(jc, JIT_SHR, JIT_RAX);
+  jitOpImm(jc, JIT_AND, JIT_RAX, 0xf);
+  jitOpReg(jc, JIT_OP_MOV, JIT_REG, JIT_RAX);
+}
+
+/* Writes the register into the codon at ptr of field. The old byte
+ * is left in r8 and the new one in rax. */
+static inline void jitWriteCodon(struct JitCache *const jc, const int32_t field)
+{
+  jitCodonAddress(jc, field);
+  jitLoadByte(jc);
+  jitOpReg(jc, JIT_OP_MOV, JIT_R8, JIT_RAX);
+  jitMovImm(jc, JIT_R9, 0xf);
+  jitShiftCl(jc, JIT_SHL, JIT_R9);
+  jitNot(jc, JIT_R9);
+  jitOpReg(jc, JIT_OP_AND, JIT_RAX, JIT_R9);
+  jitOpReg(jc, JIT_OP_MOV, JIT_R9, JIT_REG);
+  jitShiftCl(jc, JIT_SHL, JIT_R9);
+  jitOpReg(jc, JIT_OP_OR, JIT_RAX, JIT_R9);
+  jitStoreByte(jc);
+}
+
+/* Calls fn(state), with the register and energy in the state */
+static inline void jitCall(struct JitCache *const jc, void (*fn)(struct JitState *))
+{
+  jitStore(jc, JIT_FIELD(reg), JIT_REG);
+  jitStore(jc, JIT_FIELD(energy), JIT_ENERGY);
+  jitOpReg(jc, JIT_OP_MOV, JIT_RDI, JIT_RBX);
+  jitMovImm64(jc, JIT_RAX, (uint64_t)fn);
+  jitByte(jc, 0xff); /* call rax */
+  jitByte(jc, 0xd0);
+  jitLoad(jc, JIT_ENERGY, JIT_FIELD(energy));
+}
+
+/**
+ * KILL from compiled code
+ *
+ * @param st State of the VM
+ */
+static void jitKill(struct JitState *const st)
+{
+  struct VMContext *const vm = st->vm;
+  struct Cell *const cell = st->cell;
+  struct Cell *tmcell = 0;
+  uint64_t reg = st->reg, facing = st->facing, tmp = 0;
+#ifdef CYCLE_DETECTION
+  /* Counted for nothing: compiled code runs before the interpreter
+   * remembers any cycle state in this execution */
+  uint64_t cycleEffects = 0;
+#endif
+
+  cell->energy = st->energy;
+  VM_KILL(reg, cell, tmcell, facing, tmp);
+  st->energy = cell->energy;
+}
+
+/**
+ * SHARE from compiled code
+ *
+ * @param st State of the VM
+ */
+static void jitShare(struct JitState *const st)
+{
+  struct VMContext *const vm = st->vm;
+  struct Cell *const cell = st->cell;
+  struct Cell *tmcell = 0;
+  uint64_t reg = st->reg, facing = st->facing, tmp = 0;
+#ifdef CYCLE_DETECTION
+  /* Counted for nothing: compiled code runs before the interpreter
+   * remembers any cycle state in this execution */
+  uint64_t cycleEffects = 0;
+#endif
+
+  cell->energy = st->energy;
+  VM_SHARE(reg, cell, tmcell, facing, tmp);
+  st->energy = cell->energy;
+}
+
+/**
+ * Finds the REP matching a LOOP, like findLoopMatch()
+ *
+ * @param genome Genome being compiled
+ * @param length Codons compiled
+ * @param loop Position of the LOOP codon
+ * @param end Receives the position of the REP
+ * @return Codons fetched after the LOOP up to and including the REP,
+ * or 0 if the LOOP never ends or the REP is not compiled
+ */
+static uint64_t jitLoopMatch(const genome_t *const genome, const uint64_t length, const uint64_t loop, uint64_t *const end)
+{
+  uint64_t pos = loop, depth = 1, inst, n;
+
+  for(n=1;n<=(POND_DEPTH - EXEC_START_CODON);++n) {
+    pos = nextCodon(pos);
+    if (pos >= length) {
+      return 0;
+    }
+    inst = genomeCodon(genome, pos);
+    if (inst == 0x9) {
+      ++depth;
+    } else if ((inst == 0xa)&&(!--depth)) {
+      *end = pos;
+      return n;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Compiles one instruction
+ *
+ * @param jc Cache the code goes into
+ * @param genome Genome being compiled
+ * @param length Codons compiled
+ * @param p Codon position of the instruction
+ */
+static void jitInstruction(struct JitCache *const jc, const genome_t *const genome, const uint64_t length, const uint64_t p)
+{
+  const uint64_t next = nextCodon(p);
+  uint64_t a, b, n, end = 0;
+
+  /* Fetch: leave before it if there is no energy left or the codon is
+  * about to mutate, otherwise pay for it */
+  jitOpImm(jc, JIT_SUB, JIT_ENERGY, 1);
+  jitJcc(jc, JIT_CC_B, JIT_LABEL_OUT(p));
+  jitOpImm(jc, JIT_SUB, JIT_COUNTDOWN, 1);
+  jitJcc(jc, JIT_CC_E, JIT_LABEL_UNDO(p));
+
+  switch(genomeCodon(genome, p)) {
+    case 0x0: /* ZERO */
+      jitOpReg(jc, JIT_OP_XOR, JIT_REG, JIT_REG);
+      jitOpReg(jc, JIT_OP_XOR, JIT_PTR, JIT_PTR);
+      jitStoreImm(jc, JIT_FIELD(facing), 0);
+      break;
+    case 0x1: /* FWD */
+      jitIncDec(jc, 0, JIT_PTR);
+      jitOpImm(jc, JIT_AND, JIT_PTR, POND_DEPTH - 1);
+      break;
+    case 0x2: /* BACK */
+      jitIncDec(jc, 1, JIT_PTR);
+      jitOpImm(jc, JIT_AND, JIT_PTR, POND_DEPTH - 1);
+      break;
+    case 0x3: /* INC */
+      jitIncDec(jc, 0, JIT_REG);
+      jitOpImm(jc, JIT_AND, JIT_REG, 0xf);
+      break;
+    case 0x4: /* DEC */
+      jitIncDec(jc, 1, JIT_REG);
+      jitOpImm(jc, JIT_AND, JIT_REG, 0xf);
+      break;
+    case 0x5: /* READG */
+      jitReadCodon(jc, JIT_FIELD(genome));
+      break;
+    case 0x6: /* WRITEG: the code no longer matches the genome if the
+      * codon changes, so leave */
+      jitWriteCodon(jc, JIT_FIELD(genome));
+      jitOpReg(jc, JIT_OP_CMP, JIT_RAX, JIT_R8);
+      a = jitNewLabel(jc);
+      jitJcc(jc, JIT_CC_E, a);
+      jitStoreImm(jc, JIT_FIELD(wrote), 1);
+      jitExitAt(jc, next);
+      jitBind(jc, a);
+      break;
+    case 0x7: /* READB */
+      jitReadCodon(jc, JIT_FIELD(outputBuf));
+      break;
+    case 0x8: /* WRITEB */
+      jitWriteCodon(jc, JIT_FIELD(outputBuf));
+      jitFieldOp(jc, JIT_OR, JIT_FIELD(flags), FLAG_BUF);
+      break;
+    case 0x9: /* LOOP */
+      a = jitNewLabel(jc);
+      b = jitNewLabel(jc);
+      jitOpReg(jc, JIT_OP_TEST, JIT_REG, JIT_REG);
+      jitJcc(jc, JIT_CC_E, a);
+      jitOpImm(jc, JIT_CMP, JIT_LSP, POND_DEPTH);
+      jitJcc(jc, JIT_CC_AE, b);
+      jitLoad(jc, JIT_RAX, JIT_FIELD(loopStack));
+      /* mov qword [rax + rbp*8], p */
+      jitByte(jc, 0x48);
+      jitByte(jc, 0xc7);
+      jitByte(jc, 0x04);
+      jitByte(jc, 0xe8);
+      jitImm32(jc, (uint32_t)p);
+      jitIncDec(jc, 0, JIT_LSP);
+      jitJmp(jc, JIT_LABEL_POS(next));
+      /* Loop stack full */
+      jitBind(jc, b);
+      jitStoreImm(jc, JIT_FIELD(stop), 1);
+      jitExitAt(jc, next);
+      /* False LOOP: skip to the REP in one step if that uses neither
+      * all the energy nor reaches the next mutation */
+      jitBind(jc, a);
+      n = jitLoopMatch(genome, length, p, &end);
+      if (n) {
+        b = jitNewLabel(jc);
+        jitOpImm(jc, JIT_CMP, JIT_ENERGY, (int32_t)n);
+        jitJcc(jc, JIT_CC_B, b);
+        jitOpImm(jc, JIT_CMP, JIT_COUNTDOWN, (int32_t)n);
+        jitJcc(jc, JIT_CC_BE, b);
+        jitOpImm(jc, JIT_SUB, JIT_ENERGY, (int32_t)n);
+        jitOpImm(jc, JIT_SUB, JIT_COUNTDOWN, (int32_t)n);
+        jitJmp(jc, JIT_LABEL_POS(nextCodon(end)));
+        jitBind(jc, b);
+      }
+      jitStoreImm(jc, JIT_FIELD(falseLoopDepth), 1);
+      jitExitAt(jc, next);
+      break;
+    case 0xa: /* REP */
+      a = jitNewLabel(jc);
+      jitOpReg(jc, JIT_OP_TEST, JIT_LSP, JIT_LSP);
+      jitJcc(jc, JIT_CC_E, a);
+      jitIncDec(jc, 1, JIT_LSP);
+      jitOpReg(jc, JIT_OP_TEST, JIT_REG, JIT_REG);
+      jitJcc(jc, JIT_CC_E, a);
+      jitLoad(jc, JIT_RAX, JIT_FIELD(loopStack));
+      /* mov rcx, [rax + rbp*8] */
+      jitByte(jc, 0x48);
+      jitByte(jc, 0x8b);
+      jitByte(jc, 0x0c);
+      jitByte(jc, 0xe8);
+      /* jmp [table + rcx*8]; the table follows the code */
+      jitByte(jc, 0x48);
+      jitByte(jc, 0xb8);
+      jitFixup(jc, JIT_LABELS - 1);
+      jitImm32(jc, 0);
+      jitByte(jc, 0xff);
+      jitByte(jc, 0x24);
+      jitByte(jc, 0xc8);
+      jitBind(jc, a);
+      break;
+    case 0xb: /* TURN */
+      jitFieldOp(jc, JIT_AND, JIT_FIELD(flags), ~(FLAG_SHARED | FLAG_KILLED));
+      jitOpReg(jc, JIT_OP_MOV, JIT_RAX, JIT_REG);
+      jitOpImm(jc, JIT_AND, JIT_RAX, 3);
+      jitStore(jc, JIT_FIELD(facing), JIT_RAX);
+      break;
+    case 0xc: /* XCHG: the next codon is known, so only a change to it
+      * needs to leave */
+      a = jitNewLabel(jc);
+      n = genomeCodon(genome, next);
+      jitOpImm(jc, JIT_CMP, JIT_REG, (int32_t)n);
+      jitJcc(jc, JIT_CC_E, a);
+      jitStore(jc, JIT_FIELD(ptr), JIT_PTR);
+      jitMovImm(jc, JIT_PTR, (int32_t)next);
+      jitWriteCodon(jc, JIT_FIELD(genome));
+      jitStoreImm(jc, JIT_FIELD(wrote), 1);
+      jitLoad(jc, JIT_PTR, JIT_FIELD(ptr));
+      jitMovImm(jc, JIT_REG, (int32_t)n);
+      jitExitAt(jc, nextCodon(next));
+      jitBind(jc, a);
+      jitJmp(jc, JIT_LABEL_POS(nextCodon(next)));
+      break;
+    case 0xd: /* KILL */
+      a = jitNewLabel(jc);
+      jitFieldTest(jc, JIT_FIELD(flags), FLAG_KILLED);
+      jitJcc(jc, JIT_CC_NE, a);
+      jitFieldOp(jc, JIT_OR, JIT_FIELD(flags), FLAG_KILLED);
+      jitCall(jc, jitKill);
+      jitBind(jc, a);
+      break;
+    case 0xe: /* SHARE */
+      a = jitNewLabel(jc);
+      jitFieldTest(jc, JIT_FIELD(flags), FLAG_SHARED);
+      jitJcc(jc, JIT_CC_NE, a);
+      jitFieldOp(jc, JIT_OR, JIT_FIELD(flags), FLAG_SHARED);
+      jitCall(jc, jitShare);
+      jitBind(jc, a);
+      break;
+    case 0xf: /* STOP */
+      jitStoreImm(jc, JIT_FIELD(stop), 1);
+      jitExitAt(jc, next);
+      break;
+  }
+
+  if (next != p + 1) {
+    jitJmp(jc, JIT_LABEL_POS(next));
+  }
+}
+
+/**
+ * Compiles the start of a genome. The code takes a JitState, runs from
+ * the start of the genome and leaves the VM state in it.
+ *
+ * @param jc Cache the code goes into
+ * @param genome Genome to compile
+ * @param length Codons to compile, ending with a STOP unless they are
+ * the whole genome
+ * @return Code, or 0 if there is no memory for it
+ */
+/**
+ * Changes the protection of the part of the arena the next genome is
+ * compiled into, which is writable only while it is being compiled
+ *
+ * @param jc Cache of the compiling context
+ * @param prot PROT_READ | PROT_WRITE to compile, PROT_READ | PROT_EXEC after
+ * @return Nonzero on success
+ */
+static int jitProtect(struct JitCache *const jc, const int prot)
+{
+  const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+  const uint64_t from = jc->arenaUsed & ~(page - 1);
+  uint64_t to = (jc->arenaUsed + JIT_MAX_CODE + page - 1) & ~(page - 1);
+
+  if (to > JIT_ARENA_SIZE) {
+    to = JIT_ARENA_SIZE;
+  }
+  return !mprotect(jc->arena + from, to - from, prot);
+}
+
+static JitCode jitCompile(struct JitCache *const jc, const genome_t *const genome, const uint64_t length)
+{
+  uint64_t p, i;
+  uint8_t *table;
+  int64_t rel;
+
+  if (!jc->arena) {
+    return 0;
+  }
+  if (jc->arenaUsed + JIT_MAX_CODE > JIT_ARENA_SIZE) {
+    /* Out of room: forget all code */
+    for(i=0;i<JIT_CACHE_SIZE;++i) {
+      jc->entries[i].code = 0;
+    }
+    jc->arenaUsed = 0;
+  }
+  if (!jitProtect(jc, PROT_READ | PROT_WRITE)) {
+    return 0;
+  }
+  jc->start = jc->out = jc->arena + jc->arenaUsed;
+  jc->labelCount = 3 * POND_DEPTH + 1;
+  jc->fixupCount = 0;
+
+  /* Save registers and load the VM state */
+  jitByte(jc, 0x53); /* push rbx */
+  jitByte(jc, 0x55); /* push rbp */
+  jitByte(jc, 0x41); /* push r12 to r15 */
+  jitByte(jc, 0x54);
+  jitByte(jc, 0x41);
+  jitByte(jc, 0x55);
+  jitByte(jc, 0x41);
+  jitByte(jc, 0x56);
+  jitByte(jc, 0x41);
+  jitByte(jc, 0x57);
+  jitOpImm(jc, JIT_SUB, JIT_RSP, 8);
+  jitOpReg(jc, JIT_OP_MOV, JIT_RBX, JIT_RDI);
+  jitLoad(jc, JIT_REG, JIT_FIELD(reg));
+  jitLoad(jc, JIT_PTR, JIT_FIELD(ptr));
+  jitLoad(jc, JIT_ENERGY, JIT_FIELD(energy));
+  jitLoad(jc, JIT_COUNTDOWN, JIT_FIELD(countdown));
+  jitLoad(jc, JIT_LSP, JIT_FIELD(lsp));
+  jitJmp(jc, JIT_LABEL_POS(EXEC_START_CODON));
+
+  for(p=EXEC_START_CODON;p<length;++p) {
+    jitBind(jc, JIT_LABEL_POS(p));
+    jitInstruction(jc, genome, length, p);
+  }
+
+  /* An XCHG just before the STOP goes on past it, to what is not
+  * compiled */
+  if (length < POND_DEPTH) {
+    jitBind(jc, JIT_LABEL_POS(length));
+    jitExitAt(jc, length);
+  }
+
+  /* Ways out before a fetch, undoing what it paid */
+  for(p=EXEC_START_CODON;p<length;++p) {
+    jitBind(jc, JIT_LABEL_UNDO(p));
+    jitOpImm(jc, JIT_ADD, JIT_COUNTDOWN, 1);
+    jitBind(jc, JIT_LABEL_OUT(p));
+    jitOpImm(jc, JIT_ADD, JIT_ENERGY, 1);
+    jitExitAt(jc, p);
+  }
+
+  /* Store the VM state and return */
+  jitBind(jc, JIT_LABEL_EXIT);
+  jitStore(jc, JIT_FIELD(reg), JIT_REG);
+  jitStore(jc, JIT_FIELD(ptr), JIT_PTR);
+  jitStore(jc, JIT_FIELD(energy), JIT_ENERGY);
+  jitStore(jc, JIT_FIELD(countdown), JIT_COUNTDOWN);
+  jitStore(jc, JIT_FIELD(lsp), JIT_LSP);
+  jitOpImm(jc, JIT_ADD, JIT_RSP, 8);
+  jitByte(jc, 0x41); /* pop r15 to r12 */
+  jitByte(jc, 0x5f);
+  jitByte(jc, 0x41);
+  jitByte(jc, 0x5e);
+  jitByte(jc, 0x41);
+  jitByte(jc, 0x5d);
+  jitByte(jc, 0x41);
+  jitByte(jc, 0x5c);
+  jitByte(jc, 0x5d); /* pop rbp */
+  jitByte(jc, 0x5b); /* pop rbx */
+  jitByte(jc, 0xc3); /* ret */
+
+  /* Table of where each codon position starts, for REP (which only
+  * goes back to a compiled LOOP) */
+  while ((jc->out - jc->arena) & 7) {
+    jitByte(jc, 0xcc);
+  }
+  table = jc->out;
+  for(p=0;p<length;++p) {
+    jitImm64(jc, (uint64_t)(jc->start + jc->labels[JIT_LABEL_POS((p < EXEC_START_CODON) ? EXEC_START_CODON : p)]));
+  }
+
+  /* Fill in jumps, and the table address of each REP */
+  for(i=0;i<jc->fixupCount;++i) {
+    if (jc->fixups[i].label == JIT_LABELS - 1) {
+      const uint64_t t = (uint64_t)table;
+      memcpy(jc->fixups[i].at, &t, 8);
+    } else {
+      rel = (jc->start + jc->labels[jc->fixups[i].label]) - (jc->fixups[i].at + 4);
+      const int32_t rel32 = (int32_t)rel;
+      memcpy(jc->fixups[i].at, &rel32, 4);
+    }
+  }
+
+  if (!jitProtect(jc, PROT_READ | PROT_EXEC)) {
+    return 0;
+  }
+  jc->arenaUsed = (uint64_t)(jc->out - jc->arena + 63) & ~((uint64_t)63);
+  return (JitCode)(void *)jc->start;
+}
+
+/**
+ * Finds how much of a genome compiled code needs: everything up to and
+ * including the first STOP execution can reach
+ *
+ * @param genome Genome to look at
+ * @return Codons from the start of the genome
+ */
+static inline uint64_t jitLength(const genome_t *const genome)
+{
+  uint64_t i, stops;
+
+  for(i=0;i<POND_DEPTH_SYSWORDS;++i) {
+    /* Codons with all four bits set (STOP) */
+    stops = genome[i] & (genome[i] >> 1) & (genome[i] >> 2) & (genome[i] >> 3) & 0x1111111111111111ULL;
+    if (i == EXEC_START_CODON / (SYSWORD_BITS / 4)) {
+      stops &= ~((uint64_t)0) << ((EXEC_START_CODON % (SYSWORD_BITS / 4)) * 4);
+    } else if (i < EXEC_START_CODON / (SYSWORD_BITS / 4)) {
+      stops = 0;
+    }
+    if (stops) {
+      return (i * (SYSWORD_BITS / 4)) + (__builtin_ctzll(stops) / 4) + 1;
+    }
+  }
+  return POND_DEPTH;
+}
+
+/**
+ * Gets a word of the first length codons of a genome
+ *
+ * @param genome Genome
+ * @param length Codons wanted
+ * @param i Word, which must hold at least one of them
+ * @return Word with the codons after the first length zeroed
+ */
+static inline genome_t jitWord(const genome_t *const genome, const uint64_t length, const uint64_t i)
+{
+  const uint64_t n = length - (i * (SYSWORD_BITS / 4));
+
+  return (n >= (SYSWORD_BITS / 4)) ? genome[i] : (genome[i] & ((((uint64_t)1) << (n * 4)) - 1));
+}
+
+/**
+ * Hashes the first length codons of a genome
+ *
+ * @param genome Genome to hash
+ * @param length Codons to hash
+ * @return Hash
+ */
+static inline uint64_t jitHash(const genome_t *const genome, const uint64_t length)
+{
+  uint64_t h = length * 0x94d049bb133111ebULL, i;
+
+  for(i=0;(i * (SYSWORD_BITS / 4))<length;++i) {
+    h = (h ^ jitWord(genome, length, i)) * 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 29;
+  }
+  return h;
+}
+
+/**
+ * Frees the compiled code of a context, if it has any
+ *
+ * @param vm Context to free it for
+ */
+static void jitRelease(struct VMContext *const vm)
+{
+  if (vm->jit) {
+    if (vm->jit->arena) {
+      munmap(vm->jit->arena, JIT_ARENA_SIZE);
+    }
+    free(vm->jit);
+    vm->jit = 0;
+  }
+}
+
+/**
+ * Finds compiled code for a cell's genome, counting the run and
+ * compiling the genome once it is hot. A cell remembers the entry its
+ * genome was found in until the genome changes (see JIT_FORGET()), so
+ * most lookups do not look at the genome at all.
+ *
+ * @param vm Context of the executing cell
+ * @param cell Cell about to run
+ * @return Code, or 0 to interpret the genome
+ */
+static JitCode jitFind(struct VMContext *const vm, struct Cell *const cell)
+{
+  struct JitCache *jc = vm->jit;
+  const genome_t *const genome = cell->genome;
+  struct JitEntry *e;
+  genome_t *kept;
+  uint64_t h, length, i;
+
+  if (!jc) {
+    if (!(jc = vm->jit = calloc(1, sizeof(struct JitCache)))) {
+      return 0;
+    }
+    jc->arena = mmap(0, JIT_ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jc->arena == MAP_FAILED) {
+      jc->arena = 0;
+    }
+  }
+  if (!jc->arena) {
+    return 0;
+  }
+
+  /* The entry is only this context's if it lies in its cache, since
+  * the cell may last have run in another */
+  e = cell->jitEntry;
+  if ((e >= jc->entries)&&(e < (jc->entries + JIT_CACHE_SIZE))&&(e->tag == cell->jitTag)) {
+    length = e->length;
+  } else if (!cell->jitTag) {
+    /* Most genomes run once in a cell before they change, so one is
+    * only looked up when it runs again */
+    cell->jitEntry = 0;
+    cell->jitTag = 1;
+    return 0;
+  } else {
+    /* A genome that starts with STOP is not worth looking up */
+    length = jitLength(genome);
+    if (length <= EXEC_START_CODON + 1) {
+      return 0;
+    }
+    h = jitHash(genome, length);
+    e = &jc->entries[h & (JIT_CACHE_SIZE - 1)];
+    if ((e->hash == h)&&(e->length == length)&&(!e->kept)) {
+      /* Taken to be the same genome until it is copied below */
+      i = length;
+    } else if ((e->hash == h)&&(e->length == length)) {
+      for(i=0;(i * (SYSWORD_BITS / 4))<length;++i) {
+        if (jc->genomes[e - jc->entries][i] != jitWord(genome, length, i)) {
+          break;
+        }
+      }
+    } else {
+      i = 0;
+    }
+    if ((i * (SYSWORD_BITS / 4)) < length) {
+      /* Each other genome landing here wears down the runs counted for
+      * the one already here, so one that keeps running stays */
+      if (e->runs > 1) {
+        --e->runs;
+        return 0;
+      }
+      e->hash = h;
+      e->length = length;
+      e->kept = 0;
+      e->runs = 0;
+      e->code = 0;
+      ++e->tag;
+    }
+    cell->jitEntry = e;
+    cell->jitTag = e->tag;
+  }
+  kept = jc->genomes[e - jc->entries];
+  if ((!e->kept)&&(e->runs)) {
+    /* Copied from the second cell to run it. Cells that only matched
+    * its hash before now look it up again, in case theirs differs. */
+    memset(kept, 0, sizeof(jc->genomes[0]));
+    for(i=0;(i * (SYSWORD_BITS / 4))<length;++i) {
+      kept[i] = jitWord(genome, length, i);
+    }
+    e->kept = 1;
+    cell->jitTag = ++e->tag;
+  }
+  if ((!e->code)&&(++e->runs >= JIT_THRESHOLD)) {
+    e->code = jitCompile(jc, kept, length);
+  }
+  return e->code;
+}
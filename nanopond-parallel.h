@@ -0,0 +1,958 @@
+/* Parallel execution of the pond. This is included by nanopond-2.0.c
+ * when one of the parallel execution modes is selected in
+ * nanopond-params.h. */
+
+#ifdef NUMA_AWARE
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+/* Memory policies of the mbind() system call (from numaif.h) */
+#define NUMA_MPOL_PREFERRED 1
+#define NUMA_MPOL_INTERLEAVE 3
+
+/* Highest number of NUMA nodes looked at */
+#define NUMA_MAX_NODES 64
+
+/* Nodes that have CPUs this process may run on, their node numbers
+ * as seen by the kernel and the CPUs of each one */
+static uint64_t numaNodeCount = 0;
+static int numaNodeId[NUMA_MAX_NODES];
+static cpu_set_t numaNodeCpus[NUMA_MAX_NODES];
+
+/**
+ * Reads the NUMA layout of the machine from sysfs. Without it (or on a
+ * machine with one node) everything ends up on a single node holding
+ * all CPUs the process may use.
+ */
+static void numaDiscover(void)
+{
+  char path[64], buf[4096], *p;
+  cpu_set_t allowed;
+  long a, b;
+  FILE *f;
+  int n;
+
+  CPU_ZERO(&allowed);
+  sched_getaffinity(0, sizeof(allowed), &allowed);
+
+  for(n=0;n<NUMA_MAX_NODES;++n) {
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", n);
+    if (!(f = fopen(path, "r"))) {
+      continue;
+    }
+    CPU_ZERO(&numaNodeCpus[numaNodeCount]);
+    /* The list looks like 0-3,8-11 */
+    if (fgets(buf, sizeof(buf), f)) {
+      for(p=buf;(*p >= '0')&&(*p <= '9');) {
+        a = b = strtol(p, &p, 10);
+        if (*p == '-') {
+          b = strtol(p + 1, &p, 10);
+        }
+        for(;(a<=b)&&(a<CPU_SETSIZE);++a) {
+          CPU_SET(a, &numaNodeCpus[numaNodeCount]);
+        }
+        if (*p == ',') {
+          ++p;
+        }
+      }
+    }
+    fclose(f);
+
+    /* Nodes with memory only (or no usable CPUs) run no workers */
+    CPU_AND(&numaNodeCpus[numaNodeCount], &numaNodeCpus[numaNodeCount], &allowed);
+    if (CPU_COUNT(&numaNodeCpus[numaNodeCount])) {
+      numaNodeId[numaNodeCount++] = n;
+    }
+  }
+
+  /* Every node in use needs at least one worker */
+  if (numaNodeCount > NUM_THREADS) {
+    numaNodeCount = NUM_THREADS;
+  }
+  if (!numaNodeCount) {
+    numaNodeId[0] = 0;
+    numaNodeCpus[0] = allowed;
+    numaNodeCount = 1;
+  }
+  fprintf(stderr,"[INFO] %" PRIu64 " NUMA node(s), pinning %d worker threads\n", numaNodeCount, NUM_THREADS);
+}
+
+/**
+ * Gets the node a worker thread runs on. Threads are spread over the
+ * nodes in contiguous blocks, so thread t works near the t'th band of
+ * the pond.
+ *
+ * @param t Thread number
+ * @return Index of the node (not the kernel's node number)
+ */
+static inline uint64_t threadNode(const uint64_t t)
+{
+  return (t * numaNodeCount) / NUM_THREADS;
+}
+
+/**
+ * Pins the calling worker thread to one CPU of its node, the threads
+ * of a node taking its CPUs in turn.
+ *
+ * @param t Thread number
+ */
+static void pinThread(const uint64_t t)
+{
+  const uint64_t node = threadNode(t);
+  uint64_t first = t, k, cpu;
+  cpu_set_t set;
+
+  while ((first)&&(threadNode(first - 1) == node)) {
+    --first;
+  }
+  k = (t - first) % CPU_COUNT(&numaNodeCpus[node]);
+  for(cpu=0;(cpu<CPU_SETSIZE)&&(!CPU_ISSET(cpu, &numaNodeCpus[node])||(k--));++cpu);
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  if (sched_setaffinity(0, sizeof(set), &set)) {
+    perror("sched_setaffinity");
+  }
+}
+
+/**
+ * Sets the memory policy of part of the pond. Only whole pages inside
+ * the range are affected; failures (no NUMA support in the kernel)
+ * leave placement to the first write as usual.
+ *
+ * @param start First cell
+ * @param end End of the range (exclusive)
+ * @param mode NUMA_MPOL_PREFERRED or NUMA_MPOL_INTERLEAVE
+ * @param nodes Nodes to use (indices as returned by threadNode())
+ */
+static void numaBind(struct Cell *const start, struct Cell *const end, const int mode, const uint64_t nodes)
+{
+  const uintptr_t page = sysconf(_SC_PAGESIZE);
+  const uintptr_t a = ((uintptr_t)start + page - 1) & ~(page - 1);
+  const uintptr_t b = (uintptr_t)end & ~(page - 1);
+  unsigned long mask[NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+  uint64_t n;
+
+  if (b <= a) {
+    return;
+  }
+  memset(mask, 0, sizeof(mask));
+  for(n=0;n<numaNodeCount;++n) {
+    if (nodes & (UINT64_C(1) << n)) {
+      mask[numaNodeId[n] / (8 * sizeof(unsigned long))] |= 1UL << (numaNodeId[n] % (8 * sizeof(unsigned long)));
+    }
+  }
+  syscall(SYS_mbind, (void *)a, b - a, mode, mask, (unsigned long)NUMA_MAX_NODES + 1, 0UL);
+}
+#endif /* NUMA_AWARE */
+
+/* Set once the calling thread has seeded its random number generator */
+static _Thread_local int threadSeeded = 0;
+
+/**
+ * Gets the VM context of the calling worker thread, seeding its
+ * random number generator the first time the thread shows up.
+ *
+ * @param pond Pond being run
+ * @return VM context owned by the calling thread
+ */
+static inline struct VMContext *workerInit(struct Pond *const pond)
+{
+  const uint64_t t = omp_get_thread_num();
+
+  if (!threadSeeded) {
+#ifdef NUMA_AWARE
+    pinThread(t);
+#endif /* NUMA_AWARE */
+    init_genrand(pond->seed, 1 + t);
+    initVMContext(pond, &pond->vm[t]);
+    threadSeeded = 1;
+  }
+  return &pond->vm[t];
+}
+
+/**
+ * Gets the first row of the band of the pond a worker thread clears
+ * when the pond is set up. Threads get equal bands from top to bottom.
+ *
+ * @param t Thread number (NUM_THREADS for the end of the pond)
+ * @return First row of the band
+ */
+static inline uint64_t bandRow(const uint64_t t)
+{
+  return (t * POND_SIZE_Y) / NUM_THREADS;
+}
+
+/**
+ * Clears the pond on the worker threads. Each thread writes its own
+ * band first, so unless told otherwise the OS puts every band on the
+ * NUMA node of the thread that set it up.
+ *
+ * @param pond Pond to clear
+ */
+static void initPond(struct Pond *const pond)
+{
+#ifdef NUMA_AWARE
+  numaDiscover();
+#ifdef PARALLEL_TILES
+  uint64_t n;
+  /* Tiles are run on their home node (see tileNode()), so each node
+  * gets the bands of its own threads. */
+  for(n=0;n<numaNodeCount;++n) {
+    uint64_t t0 = 0, t1;
+    while (threadNode(t0) != n) {
+      ++t0;
+    }
+    for(t1=t0;(t1<NUM_THREADS)&&(threadNode(t1) == n);++t1);
+    numaBind(&POND(pond, 0, bandRow(t0)), &POND(pond, 0, bandRow(t1)), NUMA_MPOL_PREFERRED, UINT64_C(1) << n);
+  }
+#else
+  /* Picks land anywhere, so spread the pond evenly over all nodes */
+  numaBind(pond->cells, pond->cells + POND_SIZE, NUMA_MPOL_INTERLEAVE, (numaNodeCount < 64) ? ((UINT64_C(1) << numaNodeCount) - 1) : ~UINT64_C(0));
+#endif /* PARALLEL_TILES */
+#endif /* NUMA_AWARE */
+
+#pragma omp parallel num_threads(NUM_THREADS)
+  {
+    uint64_t t;
+    workerInit(pond);
+    /* Covers all bands even if fewer threads than asked for show up */
+    for(t=omp_get_thread_num();t<NUM_THREADS;t+=omp_get_num_threads()) {
+      clearPondRows(pond, bandRow(t), bandRow(t + 1));
+    }
+  }
+}
+
+#ifdef USE_SDL
+/**
+ * Redraws the whole pond; the workers do not touch the screen.
+ *
+ * @param pond Pond to draw
+ * @param screen Surface the pond is drawn on
+ */
+static void redrawScreen(struct Pond *const pond, SDL_Surface *screen)
+{
+  const uint64_t sdlPitch = screen->pitch;
+  uint64_t x, y;
+
+  if (SDL_MUSTLOCK(screen)){
+    SDL_LockSurface(screen);
+  }
+#pragma omp parallel for private(x) num_threads(NUM_THREADS)
+  for (y=0;y<POND_SIZE_Y;++y) {
+    for (x=0;x<POND_SIZE_X;++x) {
+      ((uint8_t *)screen->pixels)[x + (y * sdlPitch)] = getColor(&POND(pond, x, y));
+    }
+  }
+  if (SDL_MUSTLOCK(screen)){
+    SDL_UnlockSurface(screen);
+  }
+}
+#endif /* USE_SDL */
+
+#ifdef PARALLEL_TILES
+#define TILES_X (POND_SIZE_X / TILE_SIZE_X)
+#define TILES_Y (POND_SIZE_Y / TILE_SIZE_Y)
+#define NUM_TILES ((uint64_t)TILES_X * (uint64_t)TILES_Y)
+
+#if (POND_SIZE_X % (2 * TILE_SIZE_X)) || (POND_SIZE_Y % (2 * TILE_SIZE_Y))
+#error "The pond must be an even number of tiles wide and high"
+#endif
+#if (TILE_SIZE_X < 2) || (TILE_SIZE_Y < 2)
+#error "Tiles must be at least two cells wide and high"
+#endif
+
+/**
+ * Gets the n'th tile of a color. Colors 0..3 are the four positions
+ * in a 2x2 block of tiles, so two tiles of the same color are always
+ * separated by a tile of another color and their cells can never
+ * reach each other through getNeighbor().
+ *
+ * @param color Color of the tile
+ * @param n Index of the tile among those of the same color
+ * @return Tile number (row major)
+ */
+static inline uint64_t tileOfColor(const uint64_t color, const uint64_t n)
+{
+  const uint64_t tx = 2 * (n % (TILES_X / 2)) + (color & 1);
+  const uint64_t ty = 2 * (n / (TILES_X / 2)) + (color >> 1);
+  return ty * TILES_X + tx;
+}
+
+/**
+ * Gets a random cell inside a tile
+ *
+ * @param pond Pond the tile is in
+ * @param tile Tile number
+ * @param r Random number
+ * @return Cell in the tile
+ */
+static inline struct Cell *tileCell(struct Pond *const pond, const uint64_t tile, const uint64_t r)
+{
+  const uint64_t x = (tile % TILES_X) * TILE_SIZE_X + (r % TILE_SIZE_X);
+  const uint64_t y = (tile / TILES_X) * TILE_SIZE_Y + ((r / TILE_SIZE_X) % TILE_SIZE_Y);
+  return &POND(pond, x, y);
+}
+
+/**
+ * Executes TILE_PICKS random cells inside a tile
+ *
+ * @param vm VM context of the calling thread
+ * @param tile Tile to execute
+ * @return Energy burned by the tile's cells
+ */
+static uint64_t execTile(struct VMContext *const vm, const uint64_t tile)
+{
+  uint64_t i, burned = 0;
+
+  for(i=0;i<TILE_PICKS;++i) {
+    /* Inflow keeps its rate of one cell every INFLOW_FREQUENCY picks,
+    * but lands in the tile this thread currently owns. Since tiles
+    * are picked uniformly it is still spread evenly over the pond. */
+    if (!(++vm->picks % INFLOW_FREQUENCY)) {
+      inflow(vm->pond, tileCell(vm->pond, tile, getRandom()));
+    }
+    burned += execCell(vm, tileCell(vm->pond, tile, getRandom()));
+  }
+  return burned;
+}
+
+#if defined(TILE_WORK_STEALING) && defined(NUMA_AWARE)
+/**
+ * Gets the NUMA node a tile's cells were placed on by initPond()
+ *
+ * @param tile Tile number
+ * @return Index of the node
+ */
+static inline uint64_t tileNode(const uint64_t tile)
+{
+  const uint64_t y = (tile / TILES_X) * TILE_SIZE_Y + (TILE_SIZE_Y / 2);
+  /* Thread whose band holds row y: the last t with bandRow(t) <= y */
+  return threadNode((((y + 1) * NUM_THREADS) + POND_SIZE_Y - 1) / POND_SIZE_Y - 1);
+}
+#endif
+
+#ifdef TILE_WORK_STEALING
+/**
+ * Tiles of one color dealt out to a thread
+ */
+struct TileQueue
+{
+  /* Tiles, most expensive first; only written between phases */
+  uint32_t tiles[NUM_TILES / 4];
+
+  /* Index of the next tile (upper 32 bits) and end of the queue
+  * (lower 32 bits). The owner takes tiles from the front and thieves
+  * take them from the back; both only ever shrink the range. */
+  uint64_t range;
+
+  /* Estimated cost of the tiles dealt out */
+  uint64_t load;
+} __attribute__ ((aligned (64)));
+
+static struct TileQueue tileQueues[NUM_THREADS];
+
+/* Running estimate of the energy each tile burns per visit */
+static uint64_t tileCost[NUM_TILES];
+
+/**
+ * Gets the estimated cost of running a tile. Every pick costs at least
+ * one unit, even if it lands on an empty cell.
+ *
+ * @param tile Tile number
+ * @return Estimated cost
+ */
+static inline uint64_t tileWeight(const uint64_t tile)
+{
+  return tileCost[tile] + TILE_PICKS;
+}
+
+/**
+ * Orders tiles by decreasing estimated cost (for qsort())
+ */
+static int compareTileWeight(const void *a, const void *b)
+{
+  const uint64_t wa = tileWeight(*(const uint32_t *)a);
+  const uint64_t wb = tileWeight(*(const uint32_t *)b);
+  return (wa < wb) - (wa > wb);
+}
+
+/**
+ * Deals the tiles of a color out to the threads, most expensive tile
+ * first and always to the thread with the least work so far. With
+ * NUMA_AWARE only threads on the tile's own node are considered.
+ *
+ * @param color Color to deal out
+ */
+static void dealTiles(const uint64_t color)
+{
+  uint32_t order[NUM_TILES / 4];
+  uint64_t n, t, best, count[NUM_THREADS];
+
+  for(n=0;n<NUM_TILES/4;++n) {
+    order[n] = tileOfColor(color, n);
+  }
+  qsort(order, NUM_TILES / 4, sizeof(uint32_t), compareTileWeight);
+
+  for(t=0;t<NUM_THREADS;++t) {
+    tileQueues[t].load = 0;
+    count[t] = 0;
+  }
+  for(n=0;n<NUM_TILES/4;++n) {
+    best = NUM_THREADS;
+    for(t=0;t<NUM_THREADS;++t) {
+#ifdef NUMA_AWARE
+      if (threadNode(t) != tileNode(order[n])) {
+        continue;
+      }
+#endif /* NUMA_AWARE */
+      if ((best == NUM_THREADS)||(tileQueues[t].load < tileQueues[best].load)) {
+        best = t;
+      }
+    }
+    tileQueues[best].tiles[count[best]++] = order[n];
+    tileQueues[best].load += tileWeight(order[n]);
+  }
+  for(t=0;t<NUM_THREADS;++t) {
+    __atomic_store_n(&tileQueues[t].range, count[t], __ATOMIC_RELAXED);
+  }
+}
+
+/**
+ * Takes the next tile from the front of the calling thread's queue
+ *
+ * @param q Queue of the calling thread
+ * @param tile Receives the tile
+ * @return True if a tile was taken
+ */
+static inline int popTile(struct TileQueue *const q, uint32_t *const tile)
+{
+  uint64_t r = __atomic_load_n(&q->range, __ATOMIC_RELAXED);
+
+  while ((r >> 32) < (r & 0xffffffff)) {
+    if (__atomic_compare_exchange_n(&q->range, &r, r + (UINT64_C(1) << 32), 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      *tile = q->tiles[r >> 32];
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Steals a batch of tiles from the back of the busiest other queue,
+ * with NUMA_AWARE looking at queues on the thief's own node first.
+ *
+ * @param self Number of the calling thread
+ * @param tiles Receives up to TILE_STEAL_BATCH tiles
+ * @return Number of tiles stolen (zero once no work is left anywhere)
+ */
+static uint64_t stealTiles(const uint64_t self, uint32_t *const tiles)
+{
+  uint64_t t, r, victim, left, most, k, i;
+
+  for(;;) {
+    most = 0;
+    victim = self;
+    for(t=0;t<NUM_THREADS;++t) {
+      r = __atomic_load_n(&tileQueues[t].range, __ATOMIC_RELAXED);
+      left = (r & 0xffffffff) - (r >> 32);
+#ifdef NUMA_AWARE
+      if ((left)&&(threadNode(t) == threadNode(self))) {
+        left += NUM_TILES;
+      }
+#endif /* NUMA_AWARE */
+      if ((t != self)&&(left > most)) {
+        most = left;
+        victim = t;
+      }
+    }
+    if (!most) {
+      return 0;
+    }
+
+    r = __atomic_load_n(&tileQueues[victim].range, __ATOMIC_RELAXED);
+    left = (r & 0xffffffff) - (r >> 32);
+    if (!left) {
+      continue;
+    }
+    /* Take half of what is left, but not more than a batch */
+    k = (left + 1) / 2;
+    if (k > TILE_STEAL_BATCH) {
+      k = TILE_STEAL_BATCH;
+    }
+    if (__atomic_compare_exchange_n(&tileQueues[victim].range, &r, r - k, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      for(i=0;i<k;++i) {
+        tiles[i] = tileQueues[victim].tiles[(r & 0xffffffff) - k + i];
+      }
+      return k;
+    }
+  }
+}
+
+/**
+ * Runs tiles on the calling thread until none are left in any queue,
+ * updating the cost estimate of every tile it runs.
+ *
+ * @param vm VM context of the calling thread
+ */
+static void runTileQueues(struct VMContext *const vm)
+{
+  const uint64_t self = omp_get_thread_num();
+  uint32_t tiles[TILE_STEAL_BATCH];
+  uint32_t tile;
+  uint64_t n, i;
+
+  while (popTile(&tileQueues[self], &tile)) {
+    tileCost[tile] = (tileCost[tile] + execTile(vm, tile)) / 2;
+  }
+  while ((n = stealTiles(self, tiles))) {
+    for(i=0;i<n;++i) {
+      tileCost[tiles[i]] = (tileCost[tiles[i]] + execTile(vm, tiles[i])) / 2;
+    }
+  }
+}
+#endif /* TILE_WORK_STEALING */
+
+/**
+ * Runs every tile once, one color at a time, on all worker threads
+ *
+ * @param pond Pond to run
+ * @param clock Clock before the round
+ * @return Number of clock ticks (picks) executed
+ */
+static uint64_t runParallelRound(struct Pond *const pond, const uint64_t clock)
+{
+  /* Start with a random color so no direction is favored */
+  const uint64_t firstColor = getRandom() & 3;
+
+#pragma omp parallel num_threads(NUM_THREADS)
+  {
+    struct VMContext *const vm = workerInit(pond);
+    uint64_t c;
+#ifndef TILE_WORK_STEALING
+    uint64_t n;
+#endif
+
+    for(c=0;c<4;++c) {
+#ifdef TILE_WORK_STEALING
+      /* The barriers keep the colors from overlapping */
+#pragma omp single
+      dealTiles((firstColor + c) & 3);
+      runTileQueues(vm);
+#pragma omp barrier
+#else
+      /* The implied barrier at the end keeps colors from overlapping */
+#pragma omp for schedule(static)
+      for(n=0;n<NUM_TILES/4;++n) {
+        execTile(vm, tileOfColor((firstColor + c) & 3, n));
+      }
+#endif /* TILE_WORK_STEALING */
+    }
+  }
+  return NUM_TILES * TILE_PICKS;
+}
+#endif /* PARALLEL_TILES */
+
+#ifdef PARALLEL_RANDOM
+#if (POND_SIZE_X < 3) || (POND_SIZE_Y < 3)
+#error "PARALLEL_RANDOM needs a pond of at least 3x3 cells"
+#endif
+
+/**
+ * Tries to take a cell for the calling thread
+ *
+ * @param c Cell to claim
+ * @return True if the cell was free and is now held by the caller
+ */
+static inline int claimCell(struct Cell *const c)
+{
+  uint64_t expected = 0;
+  return __atomic_compare_exchange_n(&c->claimed, &expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+/**
+ * Hands a cell back; everything written to it becomes visible to the
+ * next thread that claims it.
+ *
+ * @param c Cell to release
+ */
+static inline void releaseCell(struct Cell *const c)
+{
+  __atomic_store_n(&c->claimed, 0, __ATOMIC_RELEASE);
+}
+
+/**
+ * Tries to take a cell together with all cells getNeighbor() can
+ * return for it. Nothing is held if this fails.
+ *
+ * @param c Center of the neighborhood
+ * @return True if the whole neighborhood is now held by the caller
+ */
+static inline int claimNeighborhood(struct Cell *const c)
+{
+  if (!claimCell(c)) {
+    return 0;
+  }
+  if (claimCell(c->lw)) {
+    if (claimCell(c->re)) {
+      if (claimCell(c->un)) {
+        if (claimCell(c->ds)) {
+          return 1;
+        }
+        releaseCell(c->un);
+      }
+      releaseCell(c->re);
+    }
+    releaseCell(c->lw);
+  }
+  releaseCell(c);
+  return 0;
+}
+
+/**
+ * Releases a neighborhood taken with claimNeighborhood()
+ *
+ * @param c Center of the neighborhood
+ */
+static inline void releaseNeighborhood(struct Cell *const c)
+{
+  releaseCell(c->ds);
+  releaseCell(c->un);
+  releaseCell(c->re);
+  releaseCell(c->lw);
+  releaseCell(c);
+}
+
+/**
+ * Executes a cell if its neighborhood can be claimed
+ *
+ * @param vm VM context of the calling thread
+ * @param cell Cell to execute
+ * @return True if the cell was executed
+ */
+static inline int tryExecCell(struct VMContext *const vm, struct Cell *const cell)
+{
+  /* A cell without energy runs no instructions and leaves everything
+  * as it was (the output buffer is cleared by the next execution if
+  * needed). Seeing zero energy is enough to count the pick as done at
+  * this instant, whoever is about to write to the cell. */
+  if (!__atomic_load_n(&cell->energy, __ATOMIC_RELAXED)) {
+    return 1;
+  }
+  if (claimNeighborhood(cell)) {
+    execCell(vm, cell);
+    releaseNeighborhood(cell);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Runs PARALLEL_ROUND_TICKS clock ticks on all worker threads. Every
+ * tick picks a cell uniformly from the whole pond. Workers take
+ * PARALLEL_CHUNK ticks at a time from the shared clock, and picks whose
+ * neighborhood is held by another worker are put aside and retried.
+ *
+ * @param pond Pond to run
+ * @param clock Clock before the round
+ * @return Number of clock ticks (picks) executed
+ */
+static uint64_t runParallelRound(struct Pond *const pond, const uint64_t clock)
+{
+  const uint64_t end = clock + PARALLEL_ROUND_TICKS;
+  uint64_t nextTick = clock;
+
+#pragma omp parallel num_threads(NUM_THREADS)
+  {
+    struct VMContext *const vm = workerInit(pond);
+    struct Cell *deferred[PARALLEL_DEFER];
+    struct Cell *cell;
+    uint64_t deferredCount = 0;
+    uint64_t tick, chunkEnd, i;
+
+    while ((tick = __atomic_fetch_add(&nextTick, PARALLEL_CHUNK, __ATOMIC_RELAXED)) < end) {
+      chunkEnd = (tick + PARALLEL_CHUNK < end) ? (tick + PARALLEL_CHUNK) : end;
+      for(;tick<chunkEnd;++tick) {
+        /* Clock ticks are counted from 1, as in the serial loop */
+        if (!((tick + 1) % INFLOW_FREQUENCY)) {
+          cell = &pond->cells[getRandom() % POND_SIZE];
+          while (!claimCell(cell)) {
+            _mm_pause();
+          }
+          inflow(pond, cell);
+          releaseCell(cell);
+        }
+
+        cell = &pond->cells[getRandom() % POND_SIZE];
+        if (!tryExecCell(vm, cell)) {
+          /* Wait for the oldest deferred pick if there is no room left */
+          if (deferredCount == PARALLEL_DEFER) {
+            while (!tryExecCell(vm, deferred[0])) {
+              _mm_pause();
+            }
+            deferred[0] = deferred[--deferredCount];
+          }
+          deferred[deferredCount++] = cell;
+        }
+
+        /* Give every deferred pick another chance */
+        for(i=0;i<deferredCount;) {
+          if (tryExecCell(vm, deferred[i])) {
+            deferred[i] = deferred[--deferredCount];
+          } else {
+            ++i;
+          }
+        }
+      }
+    }
+
+    /* The round is not over until every deferred pick has run */
+    while (deferredCount) {
+      if (tryExecCell(vm, deferred[deferredCount - 1])) {
+        --deferredCount;
+      } else {
+        _mm_pause();
+      }
+    }
+  }
+  return PARALLEL_ROUND_TICKS;
+}
+#endif /* PARALLEL_RANDOM */
+
+#ifdef PARALLEL_SPECULATIVE
+/**
+ * A clock tick planned ahead of time
+ */
+struct SpecTick
+{
+  /* Cell picked for execution */
+  struct Cell *cell;
+
+  /* Cell that receives inflow in this tick, or null */
+  struct Cell *inflowCell;
+
+  /* Key of the random stream used to run the tick */
+  uint64_t streamKey;
+
+  /* Number of cell IDs the tick took */
+  uint64_t idCount;
+
+  /* Nonzero once the tick has run */
+  int executed;
+};
+
+/* Ticks looked at ahead of time, indexed by clock % SPECULATIVE_WINDOW */
+static struct SpecTick specWindow[SPECULATIVE_WINDOW];
+
+/* Ticks found to be ready in the current wave */
+static struct SpecTick *specReady[SPECULATIVE_WINDOW];
+
+/* Number of the last wave that touched a cell (see planWave()) */
+static uint32_t specStamp[POND_SIZE];
+
+/**
+ * Works out which cells a tick will touch. The targets only depend on
+ * the seed and the tick, so any tick can be planned at any time.
+ *
+ * @param pond Pond being run
+ * @param tick Clock value of the tick (starting at 1)
+ * @param t Tick to fill in
+ */
+static inline void planTick(struct Pond *const pond, const uint64_t tick, struct SpecTick *const t)
+{
+  uint64_t key = pond->seed ^ (tick * UINT64_C(0xd1b54a32d192ed03));
+
+  t->cell = &pond->cells[splitmix64(&key) % POND_SIZE];
+  t->inflowCell = (tick % INFLOW_FREQUENCY) ? 0 : &pond->cells[splitmix64(&key) % POND_SIZE];
+  t->streamKey = splitmix64(&key);
+  t->idCount = 0;
+  __builtin_prefetch(&t->cell->energy);
+  t->executed = 0;
+}
+
+/**
+ * Runs a planned tick: inflow if it is due, then the picked cell
+ *
+ * @param vm VM context of the calling thread
+ * @param t Tick to run
+ */
+static void execTick(struct VMContext *const vm, struct SpecTick *const t)
+{
+  reseed_xorgen(t->streamKey);
+  specIdCount = 0;
+  if (t->inflowCell) {
+    inflow(vm->pond, t->inflowCell);
+  }
+  execCell(vm, t->cell);
+  t->idCount = specIdCount;
+  t->executed = 1;
+}
+
+/**
+ * Replaces the placeholder IDs a tick left in a cell
+ *
+ * @param c Cell to fix up
+ * @param base Value of the ID counter when the tick commits
+ */
+static inline void commitIds(struct Cell *const c, const uint64_t base)
+{
+  if (c->ID & SPEC_ID_TAG) {
+    c->ID = base + (c->ID & ~SPEC_ID_TAG);
+  }
+  if (c->parentID & SPEC_ID_TAG) {
+    c->parentID = base + (c->parentID & ~SPEC_ID_TAG);
+  }
+  if (c->lineage & SPEC_ID_TAG) {
+    c->lineage = base + (c->lineage & ~SPEC_ID_TAG);
+  }
+}
+
+/**
+ * Commits a tick that has run. Ticks must be committed in clock order
+ * so they take the same IDs they would have taken in a serial run.
+ *
+ * @param pond Pond being run
+ * @param t Tick to commit
+ */
+static inline void commitTick(struct Pond *const pond, struct SpecTick *const t)
+{
+  struct Cell *const c = t->cell;
+
+  /* Placeholders only exist if the tick took any IDs */
+  if (!t->idCount) {
+    return;
+  }
+  commitIds(c, pond->cellIdCounter);
+  commitIds(c->lw, pond->cellIdCounter);
+  commitIds(c->re, pond->cellIdCounter);
+  commitIds(c->un, pond->cellIdCounter);
+  commitIds(c->ds, pond->cellIdCounter);
+  if (t->inflowCell) {
+    commitIds(t->inflowCell, pond->cellIdCounter);
+  }
+  pond->cellIdCounter += t->idCount;
+}
+
+/**
+ * Marks a cell as touched by a tick of this wave
+ *
+ * @param i Index of the cell touched
+ * @param wave Wave number
+ * @return True if an earlier tick of the wave already touched it
+ */
+static inline int stampCell(const uint64_t i, const uint32_t wave)
+{
+  const int seen = (specStamp[i] == wave);
+  specStamp[i] = wave;
+  return seen;
+}
+
+/**
+ * Marks a cell and its neighbors as touched by a tick of this wave.
+ * The neighbors are worked out from the index, so the cells themselves
+ * are not loaded while planning.
+ *
+ * @param pond Pond being run
+ * @param c Center of the neighborhood
+ * @param wave Wave number
+ * @return True if an earlier tick of the wave touched any of them
+ */
+static inline int stampNeighborhood(struct Pond *const pond, struct Cell *const c, const uint32_t wave)
+{
+  const uint64_t i = c - pond->cells;
+  const uint64_t x = i % POND_SIZE_X;
+  const uint64_t row = i - x;
+  int seen = stampCell(i, wave);
+
+  seen |= stampCell(row + (x ? (x - 1) : (POND_SIZE_X - 1)), wave);
+  seen |= stampCell(row + ((x < (POND_SIZE_X - 1)) ? (x + 1) : 0), wave);
+  seen |= stampCell((i >= POND_SIZE_X) ? (i - POND_SIZE_X) : (i + POND_SIZE - POND_SIZE_X), wave);
+  seen |= stampCell((i < (POND_SIZE - POND_SIZE_X)) ? (i + POND_SIZE_X) : (i + POND_SIZE_X - POND_SIZE), wave);
+  return seen;
+}
+
+/**
+ * Finds the ticks that can run now: those that have not run yet and
+ * touch no cell an earlier uncommitted tick in the window touches.
+ * Everything a tick reads or writes lies in the picked cell's
+ * neighborhood or the inflow cell, so such ticks see exactly the state
+ * they would see in a serial run.
+ *
+ * @param pond Pond being run
+ * @param head First uncommitted tick
+ * @param tail End of the window
+ * @return Number of ticks put into specReady
+ */
+static uint64_t planWave(struct Pond *const pond, const uint64_t head, const uint64_t tail)
+{
+  static uint32_t wave = 0;
+  struct SpecTick *t;
+  uint64_t i, n = 0;
+  int seen;
+
+  if (!++wave) {
+    memset(specStamp, 0, sizeof(specStamp));
+    wave = 1;
+  }
+  for(i=head;i<tail;++i) {
+    t = &specWindow[i % SPECULATIVE_WINDOW];
+    /* Stamp every cell; a tick blocks later ones until it commits */
+    seen = stampNeighborhood(pond, t->cell, wave);
+    if (t->inflowCell) {
+      seen |= stampCell(t->inflowCell - pond->cells, wave);
+    }
+    if (!seen && !t->executed) {
+      specReady[n++] = t;
+    }
+  }
+  return n;
+}
+
+/**
+ * Runs PARALLEL_ROUND_TICKS clock ticks on all worker threads in
+ * waves of non-overlapping ticks, committing them in clock order.
+ *
+ * @param pond Pond to run
+ * @param clock Clock before the round
+ * @return Number of clock ticks (picks) executed
+ */
+static uint64_t runParallelRound(struct Pond *const pond, const uint64_t clock)
+{
+  const uint64_t end = clock + PARALLEL_ROUND_TICKS;
+  uint64_t head = clock, tail = clock;
+  uint64_t readyCount = 0;
+
+#pragma omp parallel num_threads(NUM_THREADS)
+  {
+    struct VMContext *const vm = workerInit(pond);
+    uint64_t i;
+
+    for(;;) {
+#pragma omp single
+      {
+        while ((head < tail)&&(specWindow[head % SPECULATIVE_WINDOW].executed)) {
+          commitTick(pond, &specWindow[head % SPECULATIVE_WINDOW]);
+          ++head;
+        }
+        while ((tail < end)&&((tail - head) < SPECULATIVE_WINDOW)) {
+          /* Clock ticks are counted from 1, as in the serial loop */
+          planTick(pond, tail + 1, &specWindow[tail % SPECULATIVE_WINDOW]);
+          ++tail;
+        }
+        /* The oldest uncommitted tick is always ready, so this is
+        * only zero once the whole round has been committed. */
+        readyCount = planWave(pond, head, tail);
+      }
+      if (!readyCount) {
+        break;
+      }
+#pragma omp for schedule(dynamic, 1)
+      for(i=0;i<readyCount;++i) {
+        execTick(vm, specReady[i]);
+      }
+    }
+  }
+  return PARALLEL_ROUND_TICKS;
+}
+#endif /* PARALLEL_SPECULATIVE */
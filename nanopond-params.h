@@ -64,3 +64,208 @@
 /* Define this to use a fixed random number seed.  Comment out to use
  * a time-based seed. */
 #define RANDOM_NUMBER_SEED 13
+
+/* Define this to 8 to draw random numbers from eight xorshift128+
+ * generators run side by side instead of four. Machines with AVX-512
+ * make a whole step of all eight in one go; the others get the same
+ * numbers in two or more steps. The numbers differ from those of four
+ * generators, so the pond evolves differently than without this
+ * option. Comment out to use four. */
+//#define RANDOM_LANES 8
+
+/* Define this to run the virtual machine with direct threaded dispatch
+ * (computed goto, a GCC/Clang extension): each instruction handler
+ * jumps straight to the next one through a table of labels instead of
+ * going back through one switch statement. Results are the same either
+ * way. Comment out to use the portable switch interpreter. */
+//#define VM_COMPUTED_GOTO 1
+
+/* Define this to keep a copy of each cell's genome unpacked into one
+ * byte per codon, so fetching an instruction is a byte load instead of
+ * a shift and mask of the current word. A word of the copy is unpacked
+ * the first time it is run and kept until the genome is replaced
+ * (inflow, an offspring, a KILL); writes to the cell's own genome
+ * update both copies. Makes each cell POND_DEPTH bytes bigger.
+ * Results are the same either way. Comment out to run straight from
+ * the packed genome. */
+//#define GENOME_DECODE 1
+
+/* Define this to keep track of which words of the output buffer a cell
+ * has written to, so that only those are cleared before the next cell
+ * runs and copied into an offspring (the rest of the offspring is all
+ * ones). Results are the same either way. Comment out to clear and
+ * copy the whole buffer. */
+//#define BUF_DIRTY_WORDS 1
+
+/* Define this to skip a false LOOP (one entered with a zero register)
+ * straight to its matching REP, found once per genome, instead of one
+ * codon at a time. Skipped codons still cost energy and mutate at the
+ * same rate, but the mutations are drawn with one random number each
+ * instead of one per codon, so the pond evolves differently than
+ * without this option. Comment out to skip codon by codon. */
+//#define LOOP_MATCH_TABLE 1
+
+/* Define this to draw how many instructions run until the next
+ * mutation (from the geometric distribution for MUTATION_RATE) and
+ * count down to it, instead of drawing a random number to decide for
+ * every instruction. Mutations happen at the same rate, but the pond
+ * evolves differently than without this option. Comment out to decide
+ * instruction by instruction. */
+//#define MUTATION_COUNTDOWN 1
+
+/* Define this to compile runs of instructions that neither jump,
+ * write to the genome, touch a neighbor nor stop into blocks the
+ * first time they run, and then run each block in one step: runs of
+ * FWD/BACK and of INC/DEC are added up and repeats of the rest are
+ * done once. A block is paid for at once, and not used when the cell
+ * would run out of energy or a codon would mutate in it. Results are
+ * the same either way. Needs MUTATION_COUNTDOWN. Comment out to run
+ * instruction by instruction. */
+//#define VM_BLOCKS 1
+
+/* Define this to compile the genomes that keep being run into native
+ * x86-64 code, which runs until something comes up that it leaves to
+ * the interpreter (a mutation, or a cell changing its own genome).
+ * Results are the same either way. Needs MUTATION_COUNTDOWN and an
+ * x86-64 machine with mmap() and mprotect(). Comment out to always
+ * interpret. */
+//#define VM_JIT 1
+
+/* Define this to remember, for genomes that keep being run, what they
+ * do from the start up to the first step that depends on more than
+ * the genome (a KILL, a SHARE or a change to the genome), and replay
+ * that instead of executing it. How often a trace is replayed is
+ * reported on stderr. Results are the same either way. Needs
+ * MUTATION_COUNTDOWN and cannot be used with VM_JIT. Comment out to
+ * always execute from the start. */
+//#define TRACE_CACHE 1
+
+/* Define this to recognize loops that go around without changing
+ * anything (spinning on LOOP REP until the energy runs out, say) or
+ * that copy the genome into the output buffer (READG WRITEB FWD), and
+ * run all their iterations up to the next mutation at once. Results
+ * are the same either way. Needs MUTATION_COUNTDOWN. Comment out to
+ * interpret every iteration. */
+//#define LOOP_IDIOMS 1
+
+/* Define this to remember the state of the VM each time a REP jumps
+ * back, and when a REP finds the state it left the last time with
+ * nothing written and no mutation in between, charge for as many more
+ * of those cycles as the energy pays for (up to the next mutation)
+ * at once instead of running them. Results are the same either way.
+ * Needs MUTATION_COUNTDOWN. Comment out to run every cycle. */
+//#define CYCLE_DETECTION 1
+
+/* Define this to a number of instructions after which an execution is
+ * stopped and its state parked until the cell is next picked, when it
+ * goes on from there, so that a cell with a lot of energy cannot hold
+ * everything else up for long. A parked cell may be killed, replaced
+ * or shared with before it goes on, so the pond evolves differently
+ * than without this option. Only works with the serial loop and
+ * without VM_JIT and TRACE_CACHE. Comment out to run every execution
+ * to the end. */
+//#define EXEC_QUANTUM 4096
+
+/* Define this to have the serial loop pick cells PICK_PIPELINE ticks
+ * ahead of time (a power of two), so their cache lines are prefetched
+ * while earlier cells run instead of stalling each tick on a load from
+ * a random place in the pond. How many random numbers a cell uses is
+ * only known once it has run, so the picks come from a random stream
+ * of their own: the pond evolves differently than without this option,
+ * but the same for any PICK_PIPELINE. Comment out to draw each pick
+ * from the main random stream when it is due. */
+//#define PICK_PIPELINE 16
+
+/* Define this to keep a set of the cells that have energy, so the
+ * serial loop only ever picks live cells. Picks of empty cells do
+ * nothing, so instead of making them one at a time the clock skips
+ * ahead by a random number of them, drawn with the same odds as the
+ * picks themselves (and never past the next inflow, report, dump or
+ * screen refresh). The clock, inflow and reports behave the same on
+ * average, but the pond evolves differently than without this option.
+ * Comment out to pick from the whole pond at every tick. */
+//#define ACTIVE_CELL_SET 1
+
+/* Define this to a number of events (a power of two) to be able to
+ * trace executions while the pond runs. Once switched on (see
+ * pondTrace() in nanopond.h, or the NANOPOND_TRACE_* environment
+ * variables of npx), one in every so many executions, or those of a
+ * chosen cell or genome, are interpreted instruction by instruction
+ * and every instruction is recorded as a 16-byte event in a ring of
+ * VM_TRACE events per thread, which npx writes to a file for tracedump
+ * to print. Executions that are not traced run as fast as without
+ * this option, and the pond evolves the same whether it is traced or
+ * not. Comment out to leave tracing out. */
+//#define VM_TRACE 65536
+
+/* Define this to execute the pond with several threads at once. The
+ * pond is cut into TILE_SIZE_X by TILE_SIZE_Y tiles that are colored
+ * like a 2x2 checkerboard. All tiles of one color are run at the same
+ * time, so no two threads ever touch the same cell or its neighbors.
+ * Needs OpenMP (-fopenmp). Comment out to use the serial main loop. */
+//#define PARALLEL_TILES 1
+
+/* Define this to execute the pond with several threads that each pick
+ * cells uniformly from the whole pond, just like the serial loop. A
+ * worker claims the picked cell and its four neighbors with atomic
+ * flags and defers the pick if another worker holds any of them. Needs
+ * OpenMP (-fopenmp). Comment out to use the serial main loop. */
+//#define PARALLEL_RANDOM 1
+
+/* Define this for parallel execution whose results do not depend on
+ * the number of threads: a run on NUM_THREADS threads is bit for bit
+ * the same as a run on one. Each clock tick draws its pick, inflow and
+ * mutations from its own random stream, derived from the seed and the
+ * tick number. The next SPECULATIVE_WINDOW ticks are planned ahead;
+ * ticks whose neighborhoods do not overlap an earlier unfinished tick
+ * run in parallel, and they are committed in clock order. (The random
+ * streams are laid out differently from the serial loop, so results
+ * differ from runs without this option.) Needs OpenMP (-fopenmp) to run
+ * in parallel. Comment out to use the serial main loop. */
+//#define PARALLEL_SPECULATIVE 1
+
+/* Number of worker threads used by the parallel execution modes */
+#define NUM_THREADS 8
+
+/* Define this to pin the worker threads of the parallel modes to CPUs
+ * and keep the pond close to the threads that use it on machines with
+ * several NUMA nodes. With PARALLEL_TILES each horizontal band of the
+ * pond is placed on the node of the threads that run its tiles, and
+ * tiles are dealt out to threads on their own node first. The other
+ * modes pick cells from the whole pond, so it is interleaved across
+ * all nodes. Linux only. Comment out to leave placement to the OS. */
+//#define NUMA_AWARE 1
+
+/* Tile size in cells. The pond must be an even number of tiles wide
+ * and high so the coloring still holds where the pond wraps. */
+#define TILE_SIZE_X 40
+#define TILE_SIZE_Y 40
+
+/* Number of random cells executed in each tile per color phase */
+#define TILE_PICKS 100
+
+/* Define this to balance PARALLEL_TILES with work stealing. Tiles are
+ * dealt out to the threads by their estimated cost (the energy their
+ * cells burned the last times they ran), and a thread that runs out
+ * of tiles steals up to TILE_STEAL_BATCH of the cheapest tiles left
+ * with the busiest thread. Comment out to split tiles statically. */
+#define TILE_WORK_STEALING 1
+#define TILE_STEAL_BATCH 4
+
+/* Number of cell IDs a thread reserves at a time in the parallel
+ * modes (except PARALLEL_SPECULATIVE, which numbers cells in clock
+ * order like the serial loop). */
+#define CELL_ID_BLOCK 1024
+
+/* Clock ticks run by PARALLEL_RANDOM and PARALLEL_SPECULATIVE between
+ * two checks of the periodic tasks, and ticks a PARALLEL_RANDOM worker
+ * takes from the shared clock at a time. */
+#define PARALLEL_ROUND_TICKS 65536
+#define PARALLEL_CHUNK 256
+
+/* Number of colliding picks a PARALLEL_RANDOM worker may put aside
+ * and retry later before it has to wait for one of them. */
+#define PARALLEL_DEFER 16
+
+/* Number of clock ticks PARALLEL_SPECULATIVE looks ahead */
+#define SPECULATIVE_WINDOW 512
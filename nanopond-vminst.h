@@ -4,6 +4,214 @@
 #define VM_GETINST(wp, sp, genome) \
   (genome[wp] >> sp) & 0xf
 
+/* Randomly frobs either the instruction or the register with a
+ * probability defined by MUTATION_RATE, and charges one unit of energy
+ * for the instruction. This introduces variation, and since the
+ * variation is introduced into the state of the VM it can have all
+ * manner of different effects on the end result of replication:
+ * insertions, deletions, duplications of entire ranges of the genome,
+ * etc. */
+#ifndef MUTATION_COUNTDOWN
+#define VM_MUTATE(inst, reg, tmp) \
+  if ((getRandom() & 0xffffffff) < MUTATION_RATE) { \
+    VM_MUTATION(inst, reg, tmp); \
+  } \
+  --cell->energy; \
+  ++executed;
+#else
+/* With MUTATION_COUNTDOWN the gap to the next mutation is drawn once
+ * per mutation (see mutationDistance()) and counted down instead */
+#define VM_MUTATE(inst, reg, tmp) \
+  if (!--mutationCountdown) { \
+    VM_MUTATION(inst, reg, tmp); \
+    mutationCountdown = mutationDistance(); \
+  } \
+  --cell->energy; \
+  ++executed;
+#endif /* MUTATION_COUNTDOWN */
+
+/* Frobs either the instruction or the register */
+#define VM_MUTATION(inst, reg, tmp) \
+  tmp = getRandom(); /* Call getRandom() only once for speed */ \
+  if (tmp & 0x80){ /* Check for the 8th bit to get random boolean */ \
+    inst = tmp & 0xf; /* Only the first four bits are used here */ \
+  } else { \
+    reg = tmp & 0xf; \
+  }
+
+/* Codon execution starts at (and wraps around to) */
+#define EXEC_START_CODON (EXEC_START_WORD * (SYSWORD_BITS / 4) + (EXEC_START_BIT / 4))
+
+#ifdef VM_TRACE
+/* Traced executions run every instruction on its own, without the
+ * shortcuts that run many at once (blocks, loop idioms, cycles, false
+ * LOOP skipping, compiled code and traces), so all get recorded */
+#define VM_SHORTCUTS (!traced)
+
+/* Records an event of a traced execution, see traceEvent() */
+#define VM_TRACE_EVENT(kind, inst, ip, ptr, value) \
+  if (traced) { \
+    traceEvent(vm, (kind), (inst), (ip), (ptr), reg, facing, (value)); \
+  }
+#else
+#define VM_SHORTCUTS 1
+#define VM_TRACE_EVENT(kind, inst, ip, ptr, value)
+#endif /* VM_TRACE */
+
+#ifndef GENOME_DECODE
+/* Fetches the next instruction, maybe mutated, and pays for it */
+#define VM_FETCH(inst, reg, tmp) \
+  inst = (currentWord >> shiftPtr) & 0xf; \
+  VM_MUTATE(inst, reg, tmp)
+
+/* Advances the shift and word pointers, and loops around to the
+ * beginning at the end of the genome. */
+#define VM_ADVANCE(wp, sp) \
+  if ((sp += 4) >= SYSWORD_BITS) { \
+    if (++wp >= POND_DEPTH_SYSWORDS) { \
+      wp = EXEC_START_WORD; \
+      sp = EXEC_START_BIT; \
+    } else { \
+      sp = 0; \
+    } \
+    currentWord = cell->genome[wp]; \
+  }
+
+/* Moves the instruction pointer to a codon position, which may be
+ * the end of the genome to loop around to the beginning */
+#define VM_JUMP(wp, sp, pos) \
+  if ((pos) >= POND_DEPTH) { \
+    wp = EXEC_START_WORD; \
+    sp = EXEC_START_BIT; \
+  } else { \
+    wp = (pos) / (SYSWORD_BITS / 4); \
+    sp = ((pos) % (SYSWORD_BITS / 4)) * 4; \
+  } \
+  currentWord = cell->genome[wp];
+
+#ifdef LOOP_MATCH_TABLE
+/* Skips a false LOOP at once, see skipFalseLoop() */
+#define VM_SKIP_FALSE_LOOP(wp, sp, reg, falseLoopDepth) \
+  if (VM_SHORTCUTS) { \
+    executed += cell->energy; \
+    tmp = skipFalseLoop(vm, cell, VM_GETPOS(wp, sp), &reg, &falseLoopDepth, &mutationCountdown); \
+    executed -= cell->energy; \
+    wp = tmp / (SYSWORD_BITS / 4); \
+    sp = (tmp % (SYSWORD_BITS / 4)) * 4; \
+    currentWord = cell->genome[wp]; \
+  }
+#endif /* LOOP_MATCH_TABLE */
+#else
+/* With GENOME_DECODE the instruction pointer is one index into the
+ * genome decoded to a codon per byte (code[]), so fetching and moving
+ * on need no shifting. The variants below work on that index; the
+ * memory pointer and all other instructions work as usual. */
+
+/* Decodes the word of the genome holding codon ip if it is not yet */
+#define VM_DECODE(ip) \
+  if (!((cell->decoded >> ((ip) / (SYSWORD_BITS / 4))) & 1)) { \
+    decodeWord(code, cell, (ip) / (SYSWORD_BITS / 4)); \
+  }
+
+/* Fetches the next instruction, maybe mutated, and pays for it */
+#define VM_FETCH(inst, reg, tmp) \
+  VM_DECODE(ip); \
+  inst = code[ip]; \
+  VM_MUTATE(inst, reg, tmp)
+
+/* Advances the instruction pointer, wrapping at the end of the genome */
+#define VM_ADVANCE(ip) \
+  if (++ip >= POND_DEPTH) { \
+    ip = EXEC_START_CODON; \
+  }
+
+/* Moves the instruction pointer to a codon position, which may be
+ * the end of the genome to loop around to the beginning */
+#define VM_JUMP(ip, pos) \
+  ip = ((pos) >= POND_DEPTH) ? EXEC_START_CODON : (pos);
+
+#ifdef LOOP_MATCH_TABLE
+/* Skips a false LOOP at once, see skipFalseLoop() */
+#define VM_SKIP_FALSE_LOOP(ip, reg, falseLoopDepth) \
+  if (VM_SHORTCUTS) { \
+    executed += cell->energy; \
+    ip = skipFalseLoop(vm, cell, ip, &reg, &falseLoopDepth, &mutationCountdown); \
+    executed -= cell->energy; \
+  }
+#endif /* LOOP_MATCH_TABLE */
+#endif /* GENOME_DECODE */
+
+#ifndef LOOP_MATCH_TABLE
+#ifdef GENOME_DECODE
+#define VM_SKIP_FALSE_LOOP(ip, reg, falseLoopDepth)
+#else
+#define VM_SKIP_FALSE_LOOP(wp, sp, reg, falseLoopDepth)
+#endif
+#endif /* LOOP_MATCH_TABLE */
+
+#ifdef LOOP_IDIOMS
+/* Runs the iterations of a loop that is going around again at once if
+ * it is one that runLoopIdiom() recognizes */
+#define VM_LOOP_IDIOM(loop, rep) \
+  if (VM_SHORTCUTS) { \
+    uint64_t idiomPtr = VM_GETPOS(ptr_wordPtr, ptr_shiftPtr), idiomStart = idiomPtr; \
+    tmp = runLoopIdiom(cell, (loop), (rep), &reg, &idiomPtr, &facing, &flags, outputBuf, mutationCountdown); \
+    cell->energy -= tmp; \
+    mutationCountdown -= tmp; \
+    executed += tmp; \
+    ptr_wordPtr = idiomPtr / (SYSWORD_BITS / 4); \
+    ptr_shiftPtr = (idiomPtr % (SYSWORD_BITS / 4)) * 4; \
+    if ((tmp)&&(idiomPtr != idiomStart)&&(flags & FLAG_BUF)) { \
+      VM_MARK_BUF_SPAN(idiomStart, idiomPtr); \
+      VM_CYCLE_EFFECT(); \
+    } \
+  }
+#else
+#define VM_LOOP_IDIOM(loop, rep)
+#endif /* LOOP_IDIOMS */
+
+#ifdef CYCLE_DETECTION
+/* Notes a change to state a cycle could depend on that is not kept in
+ * struct CycleState: the genome, the output buffer, a neighbor or the
+ * loop stack below its top */
+#define VM_CYCLE_EFFECT() \
+  ++cycleEffects;
+
+/* Skips the cycles ahead if the state at a REP jumping back repeats,
+ * see findCycle() */
+#define VM_CYCLE_CHECK(rep, lsp) \
+  if (VM_SHORTCUTS) { \
+    tmp = findCycle(vm, cell, (rep), reg, VM_GETPOS(ptr_wordPtr, ptr_shiftPtr), facing, flags, lsp, cycleEffects, executed, mutationCountdown); \
+    cell->energy -= tmp; \
+    mutationCountdown -= tmp; \
+    executed += tmp; \
+  }
+#else
+#define VM_CYCLE_EFFECT()
+#define VM_CYCLE_CHECK(rep, lsp)
+#endif /* CYCLE_DETECTION */
+
+#ifdef EXEC_QUANTUM
+/* Holds back the energy the cell has beyond what is left of the
+ * quantum, so that running out of energy stops the execution at the
+ * end of the quantum at no extra cost */
+#define VM_HOLD_ENERGY() \
+  energyHeld = (cell->energy > EXEC_QUANTUM - executed) ? (cell->energy - (EXEC_QUANTUM - executed)) : 0; \
+  cell->energy -= energyHeld;
+
+/* Gives the cell back the energy held back from it */
+#define VM_RELEASE_ENERGY() \
+  cell->energy += energyHeld; \
+  energyHeld = 0;
+
+/* Energy the cell has, held back or not */
+#define VM_ENERGY_LEFT (cell->energy + energyHeld)
+#else
+#define VM_HOLD_ENERGY()
+#define VM_RELEASE_ENERGY()
+#define VM_ENERGY_LEFT (cell->energy)
+#endif /* EXEC_QUANTUM */
+
 /* ZERO: Zero VM state registers */
 #define VM_ZERO(reg, mwp, msp, facing) \
   DEBUG_VM("ZERO:\treg: %"PRIx64" facing: %"PRIu64" -> ", reg, facing); \
@@ -24,6 +232,14 @@
   } \
   DEBUG_VM("%"PRIx64 "\n", VM_GETPOS(mwp, msp));
 
+/* Moves the pointer forward by a number of codons (wrap at end) */
+#define VM_MOVE(mwp, msp, amt) \
+  DEBUG_VM("MOVE:\tmemptr: %"PRIx64" -> ", VM_GETPOS(mwp, msp)); \
+  tmp = (VM_GETPOS(mwp, msp) + (amt)) % POND_DEPTH; \
+  mwp = tmp / (SYSWORD_BITS / 4); \
+  msp = (tmp % (SYSWORD_BITS / 4)) * 4; \
+  DEBUG_VM("%"PRIx64 "\n", VM_GETPOS(mwp, msp));
+
 /* BACK: Decrement the pointer (wrap at beginning) */
 #define VM_BACK(reg, mwp, msp) \
   DEBUG_VM("BACK:\tmemptr: %"PRIx64" -> ", VM_GETPOS(mwp, msp)); \
@@ -60,9 +276,49 @@
   DEBUG_VM("WRITEG:\treg: %"PRIx64" dna: %"PRIx64" -> ", reg, VM_GETINST(mwp, msp, genome)); \
   genome[mwp] &= ~(((genome_t)0xf) << msp); \
   genome[mwp] |= reg << msp; \
-  currentWord = genome[wordPtr]; \
+  VM_REFRESH(mwp, msp, reg); \
+  VM_CYCLE_EFFECT(); \
   DEBUG_VM("%"PRIx64 "\n", VM_GETINST(mwp, msp, genome));
 
+/* Brings the executing copy of the genome up to date after a write */
+#ifdef GENOME_DECODE
+#define VM_REFRESH(mwp, msp, val) \
+  code[(mwp) * (SYSWORD_BITS / 4) + ((msp) / 4)] = (val); \
+  VM_FORGET_CODE(); \
+  JIT_FORGET(cell);
+#else
+#define VM_REFRESH(mwp, msp, val) \
+  currentWord = cell->genome[wordPtr]; \
+  VM_FORGET_CODE(); \
+  JIT_FORGET(cell);
+#endif /* GENOME_DECODE */
+
+/* Drops what was derived from the genome after a write to it */
+#ifdef CODE_CACHE
+#define VM_FORGET_CODE() forgetCode(vm);
+#else
+#define VM_FORGET_CODE()
+#endif
+
+/* Notes that a word of the output buffer has been written to */
+#ifdef BUF_DIRTY_WORDS
+#define VM_MARK_BUF(mwp) \
+  bufDirty[(mwp) / 64] |= ((uint64_t)1) << ((mwp) % 64);
+
+/* Notes the words from one codon position to another (going forward
+ * and wrapping around) as written to */
+#define VM_MARK_BUF_SPAN(from, to) \
+  for(tmp=(from)/(SYSWORD_BITS/4);;tmp=(tmp+1)%POND_DEPTH_SYSWORDS) { \
+    VM_MARK_BUF(tmp); \
+    if (tmp == (to)/(SYSWORD_BITS/4)) { \
+      break; \
+    } \
+  }
+#else
+#define VM_MARK_BUF(mwp)
+#define VM_MARK_BUF_SPAN(from, to)
+#endif
+
 /* READB: Read into the register from buffer */
 #define VM_READB(reg, mwp, msp, outputBuf) \
   DEBUG_VM("READB:\tbuf: %"PRIx64" reg: %"PRIx64" -> ", VM_GETINST(mwp, msp, outputBuf), reg); \
@@ -74,8 +330,11 @@
   DEBUG_VM("WRITEB:\treg: %"PRIx64" buf: %"PRIx64" -> ", reg, VM_GETINST(mwp, msp, outputBuf)); \
   outputBuf[mwp] &= ~(((genome_t)0xf) << msp); \
   outputBuf[mwp] |= reg << msp; \
+  VM_MARK_BUF(mwp); \
+  VM_CYCLE_EFFECT(); \
   DEBUG_VM("%"PRIx64 "\n", VM_GETINST(mwp, msp, outputBuf)); \
 
+#ifndef GENOME_DECODE
 /* LOOP: Jump forward to matching REP if register is zero */
 #define VM_LOOP(reg, wp, sp, lsp, ls_wp, ls_sp, stop, falseLoopDepth) \
   DEBUG_VM("LOOP:\tiptr: %"PRIx64" ", VM_GETPOS(wp, sp)); \
@@ -92,6 +351,7 @@
   } else { \
     DEBUG_VM("%u ", 0); \
     falseLoopDepth = 1; \
+    VM_SKIP_FALSE_LOOP(wp, sp, reg, falseLoopDepth); \
   } \
   DEBUG_VM("falseLoopDepth: %"PRIx64", loopstack %"PRIx64") -> iptr: %"PRIx64"\n", falseLoopDepth, lsp, VM_GETPOS(wp, sp));
 
@@ -102,6 +362,8 @@
   if (lsp) { \
     --lsp; \
     if (reg) { \
+      VM_LOOP_IDIOM(VM_GETPOS(ls_wp[lsp], ls_sp[lsp]), VM_GETPOS(wp, sp)); \
+      VM_CYCLE_CHECK(VM_GETPOS(wp, sp), lsp); \
       wp = ls_wp[lsp]; \
       sp = ls_sp[lsp]; \
       currentWord = cell->genome[wp]; \
@@ -109,8 +371,50 @@
       DEBUG_VM("%u] -> iptr: %"PRIx64"\n", 1, VM_GETPOS(wp, sp)); \
       continue; \
     } \
+    /* The stack no longer goes back to what it was */ \
+    VM_CYCLE_EFFECT(); \
   } \
   DEBUG_VM("%u] -> iptr: %"PRIx64"\n", 0, VM_GETPOS(wp, sp));
+#else
+/* With GENOME_DECODE the loop stack holds decoded instruction pointers */
+/* LOOP: Jump forward to matching REP if register is zero */
+#define VM_LOOP(reg, ip, lsp, ls_ip, stop, falseLoopDepth) \
+  DEBUG_VM("LOOP:\tiptr: %"PRIx64" ", (uint64_t)(ip)); \
+  DEBUG_VM("(reg: %"PRIx64" jump: ", reg); \
+  if (reg) { \
+    DEBUG_VM("%u ", 1); \
+    if (lsp >= POND_DEPTH){ \
+      stop = 1; \
+    } else { \
+      ls_ip[lsp] = ip; \
+      ++lsp; \
+    } \
+  } else { \
+    DEBUG_VM("%u ", 0); \
+    falseLoopDepth = 1; \
+    VM_SKIP_FALSE_LOOP(ip, reg, falseLoopDepth); \
+  } \
+  DEBUG_VM("falseLoopDepth: %"PRIx64", loopstack %"PRIx64") -> iptr: %"PRIx64"\n", falseLoopDepth, lsp, (uint64_t)(ip));
+
+/* REP: Jump back to matching LOOP if register is nonzero */
+#define VM_REP(reg, ip, lsp, ls_ip) \
+  DEBUG_VM("REP:\tiptr: %"PRIx64" ", (uint64_t)(ip)); \
+  DEBUG_VM("[(reg: %"PRIx64", loopstack: %"PRIx64") jump: ", reg, lsp); \
+  if (lsp) { \
+    --lsp; \
+    if (reg) { \
+      VM_LOOP_IDIOM(ls_ip[lsp], ip); \
+      VM_CYCLE_CHECK(ip, lsp); \
+      ip = ls_ip[lsp]; \
+      /* This ensures that the LOOP is rerun */ \
+      DEBUG_VM("%u] -> iptr: %"PRIx64"\n", 1, (uint64_t)(ip)); \
+      continue; \
+    } \
+    /* The stack no longer goes back to what it was */ \
+    VM_CYCLE_EFFECT(); \
+  } \
+  DEBUG_VM("%u] -> iptr: %"PRIx64"\n", 0, (uint64_t)(ip));
+#endif /* GENOME_DECODE */
 
 /* TURN: Turn in the direction specified by register */ \
 #define VM_TURN(reg, facing) \
@@ -118,6 +422,7 @@
   facing = reg & 3; \
   DEBUG_VM("%"PRIu64 "\n", facing);
 
+#ifndef GENOME_DECODE
 /* XCHG: Skip next instruction and exchange value of register with it */
 #define VM_XCHG(reg, wp, sp, genome, tmp) \
   DEBUG_VM("XCHG:\tiptr: %"PRIx64" ", VM_GETPOS(wp, sp)); \
@@ -135,27 +440,49 @@
   genome[wp] &= ~(((genome_t)0xf) << sp); \
   genome[wp] |= tmp << sp; \
   currentWord = genome[wp]; \
+  VM_FORGET_CODE(); \
+  JIT_FORGET(cell); \
+  VM_CYCLE_EFFECT(); \
   DEBUG_VM("%"PRIx64 ") -> iptr: %"PRIx64"\n", VM_GETINST(wp, sp, genome), VM_GETPOS(wp, sp));
+#else
+/* XCHG: Skip next instruction and exchange value of register with it */
+#define VM_XCHG(reg, ip, genome, tmp) \
+  DEBUG_VM("XCHG:\tiptr: %"PRIx64" ", (uint64_t)(ip)); \
+  VM_ADVANCE(ip); \
+  VM_DECODE(ip); \
+  tmp = reg; \
+  reg = code[ip]; \
+  code[ip] = tmp; \
+  genome[(ip) / (SYSWORD_BITS / 4)] &= ~(((genome_t)0xf) << (((ip) % (SYSWORD_BITS / 4)) * 4)); \
+  genome[(ip) / (SYSWORD_BITS / 4)] |= tmp << (((ip) % (SYSWORD_BITS / 4)) * 4); \
+  VM_FORGET_CODE(); \
+  JIT_FORGET(cell); \
+  VM_CYCLE_EFFECT(); \
+  DEBUG_VM("(reg: %"PRIx64" -> %"PRIx64" dna: %"PRIx64") -> iptr: %"PRIx64"\n", tmp, reg, (uint64_t)code[ip], (uint64_t)(ip));
+#endif /* GENOME_DECODE */
 
 /* KILL: Blow away neighboring cell if allowed with penalty on failure */
 #define VM_KILL(reg, cell, tmcell, facing, tmp) \
   DEBUG_VM("KILL\t"); \
+  VM_RELEASE_ENERGY(); \
+  VM_CYCLE_EFFECT(); \
   tmcell = getNeighbor(cell,facing); \
   DEBUG_VM("target: %"PRIu64"\t parentid: %"PRIu64"\t", tmcell->ID, tmcell->parentID); \
   if (accessAllowed(tmcell,reg,0)) { \
     DEBUG_VM("SUCCESS\n"); \
     if (tmcell->generation > 2){ \
-      ++statCounters.viableCellsKilled; \
+      STAT_INC(viableCellsKilled); \
     } \
     /* Filling first two words with 0xfffff... is enough */ \
     for (int j = 0; j < POND_DEPTH_SYSWORDS; j++) { \
       tmcell->genome[j] = ~((genome_t)0); \
     } \
-    tmcell->ID = cellIdCounter; \
+    GENOME_CHANGED(tmcell); \
+    tmp = CELL_ID_POSTINC(vm->pond); \
+    tmcell->ID = tmp; \
     tmcell->parentID = 0; \
-    tmcell->lineage = cellIdCounter; \
+    tmcell->lineage = tmp; \
     tmcell->generation = 0; \
-    ++cellIdCounter; \
   } else if (tmcell->generation > 2) { \
     DEBUG_VM("FAILURE\tenergy: %"PRIu64" -> ", cell->energy); \
     tmp = cell->energy / FAILED_KILL_PENALTY; \
@@ -167,24 +494,29 @@
     DEBUG_VM("%"PRIu64"\n", cell->energy); \
   } else { \
     DEBUG_VM("FAILURE\n"); \
-  }
+  } \
+  VM_HOLD_ENERGY();
 
 /* SHARE: Equalize energy between self and neighbor if allowed */
 #define VM_SHARE(reg, cell, tmcell, facing, tmp) \
   DEBUG_VM("SHARE\t"); \
+  VM_RELEASE_ENERGY(); \
+  VM_CYCLE_EFFECT(); \
   tmcell = getNeighbor(cell,facing); \
   if (accessAllowed(tmcell,reg,1)) { \
     DEBUG_VM("SUCCESS\tenergy: %"PRIu64" -> ", cell->energy); \
     if (tmcell->generation > 2) { \
-      ++statCounters.viableCellShares; \
+      STAT_INC(viableCellShares); \
     } \
     tmp = cell->energy + tmcell->energy; \
     tmcell->energy = tmp / 2; \
     cell->energy = tmp - tmcell->energy; \
+    ENERGY_CHANGED(vm->pond, tmcell); \
     DEBUG_VM("%"PRIu64"\n", cell->energy); \
   } else { \
     DEBUG_VM("FAILURE\n"); \
-  }
+  } \
+  VM_HOLD_ENERGY();
 
 /* STOP: End execution */
 #define VM_STOP(stop) \
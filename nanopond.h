@@ -0,0 +1,114 @@
+/* Interface for running nanopond from other programs. Built with
+ * NANOPOND_LIBRARY defined, nanopond-2.0.c has no main() and no
+ * display, reports or dumps, and is linked as libnanopond (see the
+ * Makefile); npx is one program that drives it. Everything that
+ * belongs to a pond is kept in its struct Pond, so any number of ponds
+ * can run in one process, each stepped by one thread at a time. The
+ * size of the pond and all other parameters are fixed when the
+ * library is compiled, from nanopond-params.h. */
+
+#ifndef NANOPOND_H
+#define NANOPOND_H
+
+#include <stdint.h>
+#include "nanopond-params.h"
+
+/* Genome size in 64-bit words, each holding 16 four-bit codons */
+#define POND_GENOME_WORDS (POND_DEPTH / 16)
+
+struct Pond;
+
+/**
+ * A cell as copied out of the pond by pondSnapshot()
+ */
+struct PondCell
+{
+  uint64_t ID;
+  uint64_t parentID;
+  uint64_t lineage;
+  uint64_t generation;
+  uint64_t energy;
+  uint64_t genome[POND_GENOME_WORDS];
+};
+
+/* Creates a pond with all cells empty and its own random number
+ * stream, or returns 0 if there is not enough memory */
+struct Pond *pondCreate(uint64_t seed);
+
+/* Frees a pond */
+void pondDestroy(struct Pond *pond);
+
+/* Runs a pond for a number of clock ticks and returns its clock */
+uint64_t pondStep(struct Pond *pond, uint64_t ticks);
+
+/* Gets the number of clock ticks a pond has run */
+uint64_t pondClock(const struct Pond *pond);
+
+/* Puts a cell with a given genome and energy at (x, y) */
+void pondInject(struct Pond *pond, uint64_t x, uint64_t y, const uint64_t *genome, uint64_t energy);
+
+/* Copies cells out of a pond, in row order from index first, and
+ * returns the number copied */
+uint64_t pondSnapshot(const struct Pond *pond, uint64_t first, uint64_t count, struct PondCell *cells);
+
+/* Selects nothing in struct PondTrace */
+#define PONDTRACE_NONE (~(uint64_t)0)
+
+/**
+ * Executions to trace, see pondTrace()
+ */
+struct PondTrace
+{
+  /* Trace one in this many executions (0 for none) */
+  uint64_t every;
+
+  /* Trace every execution of the cell at this index (y * POND_SIZE_X
+   * + x), or PONDTRACE_NONE */
+  uint64_t cell;
+
+  /* Trace every execution of a cell whose genome hashes to this (see
+   * pondGenotype()), or PONDTRACE_NONE */
+  uint64_t genotype;
+};
+
+/* Kinds of trace events */
+#define PONDTRACE_CONTEXT 1   /* The events after this come from VM context inst; value is how many of its events were lost before them */
+#define PONDTRACE_START 2     /* A traced execution starts: the cell at (ip, ptr) with ID value, going on from a parked execution if inst is 1 */
+#define PONDTRACE_INST 3      /* An instruction is fetched: inst is the instruction (low four bits) and the codon it was fetched from (high four bits), value the energy left after paying for it */
+#define PONDTRACE_SKIP 4      /* As PONDTRACE_INST, for an instruction passed over looking for the REP of a false LOOP */
+#define PONDTRACE_OFFSPRING 5 /* The output buffer is copied into the cell at (ip, ptr), which gets ID value */
+#define PONDTRACE_END 6       /* The execution ends after value instructions, parked if inst is 1 */
+
+/**
+ * An event recorded by a traced execution. Unless said otherwise ip
+ * and ptr are the instruction and memory pointers (codon positions),
+ * and reg and facing the VM registers, before the event.
+ */
+struct PondTraceEvent
+{
+  uint8_t kind;
+  uint8_t inst;
+  uint16_t ip;
+  uint16_t ptr;
+  uint8_t reg;
+  uint8_t facing;
+  uint64_t value;
+};
+
+#ifdef VM_TRACE
+/* Sets which executions of a pond are traced, or switches tracing off
+ * if trace is 0 */
+void pondTrace(struct Pond *pond, const struct PondTrace *trace);
+
+/* Takes up to count of the events traced in a pond that have not been
+ * taken yet and returns the number taken. Events of each VM context
+ * come in order, after a PONDTRACE_CONTEXT event; when more were
+ * traced than VM_TRACE since the last call, the oldest are lost. This
+ * may be called while another thread steps the pond. */
+uint64_t pondTraceRead(struct Pond *pond, struct PondTraceEvent *events, uint64_t count);
+
+/* Hashes a genome for selecting it in struct PondTrace */
+uint64_t pondGenotype(const uint64_t *genome);
+#endif /* VM_TRACE */
+
+#endif /* NANOPOND_H */
@@ -0,0 +1,502 @@
+#include <assert.h>
+#include <sys/time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#define _XOPEN_SOURCE 600
+#include <stdlib.h>
+#include <immintrin.h>  // Intel intrinsics, see https://software.intel.com/sites/landingpage/IntrinsicsGuide/
+
+/*
+ * Experimental lane-parallel VM: eight cells run at once in the 32-bit lanes of AVX2 registers, against the
+ * scalar interpreter they would otherwise run in, on the same batch of cells.
+ *
+ * Every step each lane fetches its own codon (one gather for all lanes) and the effects of all instructions are
+ * computed and blended in under per-instruction masks, so divergent instructions and LOOP/REP control flow cost
+ * no branches. Lanes that run a false LOOP skip codons under their own mask until the matching REP. Stores into
+ * the genome and the output buffer and pushes onto the loop stack have no AVX2 form (there is no scatter), so
+ * they are done lane by lane for the lanes that need them. A lane whose cell ends is refilled from the batch at
+ * once. A lane retires its cell to the scalar path when it reaches KILL or SHARE (which need the neighbors) or a
+ * loop deeper than its stack; in nanopond proper replication (copying out the buffer) and mutations would do the
+ * same. Neither exists here: KILL and SHARE do nothing in the scalar path and nothing mutates, so both ways of
+ * running the batch must leave exactly the same cells, which is checked.
+ *
+ * Build with "make lanes" and run ./lanes.
+ */
+
+#ifndef __AVX2__
+#error "lanes.c needs AVX2 (build with -mavx2 or -march=native)"
+#endif
+
+/**************************************************************************************************************************/
+// Useful #defines
+//
+/**************************************************************************************************************************/
+#define START_TIMER gettimeofday(&start, NULL)
+#define STOP_TIMER gettimeofday(&end, NULL)
+#define DELTA_TIMER ((end.tv_sec-start.tv_sec)+(end.tv_usec-start.tv_usec)/1000000.0)
+
+#define POND_DEPTH 512					// Codons in a genome, as in nanopond-params.h
+#define POND_DEPTH_SYSWORDS (POND_DEPTH / 16)
+#define EXEC_START_CODON 1
+#define LANES 8
+#define LANE_GROUPS 1					// Groups of lanes stepped in turn, so their gathers can overlap
+#define LANE_STACK 64					// Loop stack depth a lane handles before it retires its cell
+#define CELLS 16384					// Cells in a batch
+#define CELL_ENERGY 1024				// Energy each cell starts with
+#define REPEATS 5
+
+/**************************************************************************************************************************/
+// Data types and global variables.
+//
+/**************************************************************************************************************************/
+// State of the VM running a cell, with the pointers and the loop stack as codon positions.
+struct vm_state {
+	uint32_t ip, ptr, reg, facing, energy, lsp, fld, stop;
+	uint32_t retired;				// Handed over from a lane to the scalar path
+	uint32_t stack[POND_DEPTH];
+};
+
+struct cell {
+	uint64_t genome[POND_DEPTH_SYSWORDS];
+	uint64_t out[POND_DEPTH_SYSWORDS];		// Output buffer
+	struct vm_state st;
+} __attribute__ ((aligned (64)));
+
+static struct cell initial[CELLS], scalar[CELLS], lanes[CELLS + 1];	// The last one is scratch for idle lanes
+static struct timeval start, end;
+
+/**************************************************************************************************************************/
+// Function declarations
+//
+/**************************************************************************************************************************/
+static        void     make_batch(int loopy, uint64_t seed);
+static        uint64_t run_scalar(struct cell *c);
+static        uint64_t run_lanes(struct cell *c, uint64_t n);
+static        int      compare_batches();
+
+/**************************************************************************************************************************/
+// main
+//
+/**************************************************************************************************************************/
+int main(){
+	uint64_t i, j, codons;
+	double ts, tl;
+	int loopy;
+
+	for(loopy=0; loopy<2; loopy++){
+		make_batch(loopy, 13);
+		ts = tl = 0.0;
+		for(j=0; j<REPEATS; j++){
+			memcpy(scalar, initial, sizeof(initial));
+			START_TIMER;
+			codons = 0;
+			for(i=0; i<CELLS; i++){
+				codons += run_scalar(&scalar[i]);
+			}
+			STOP_TIMER;
+			ts += DELTA_TIMER;
+
+			memcpy(lanes, initial, sizeof(initial));
+			START_TIMER;
+			if (run_lanes(lanes, CELLS) != codons) {
+				fprintf(stdout, "codon counts differ\n");
+				return 1;
+			}
+			STOP_TIMER;
+			tl += DELTA_TIMER;
+
+			if (!compare_batches()) {
+				return 1;
+			}
+		}
+		fprintf(stdout, "%s genomes, %lu codons per batch: scalar %lfs, %d lanes %lfs (%.2fx)\n",
+			loopy ? "Looping" : "Random", codons, ts / REPEATS, LANES * LANE_GROUPS, tl / REPEATS, ts / tl);
+	}
+/*
+ * gcc -O3 -march=native results (Xeon with AVX-512, AVX2 code)
+ *
+ * Random genomes, 3019634 codons per batch: scalar 0.020572s, 8 lanes 0.024705s (0.83x)
+ * Looping genomes, 4947675 codons per batch: scalar 0.028562s, 8 lanes 0.035939s (0.79x)
+ *
+ * With LANE_GROUPS 2 or 4 the lanes are no faster, so the steps are not waiting on their gathers: a step takes
+ * a gather or two, around 60 vector instructions and the stores done lane by lane, which is more than eight
+ * steps of the scalar interpreter, branch mispredictions included.
+ */
+
+	return 0;
+}
+
+/**************************************************************************************************************************/
+// Batches of cells
+//
+/**************************************************************************************************************************/
+static uint64_t splitmix64(uint64_t *state) {
+	uint64_t z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+	z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+	return z ^ (z >> 31);
+}
+
+static inline uint32_t codon_at(const uint64_t *g, uint32_t p) {
+	return (g[p / 16] >> ((p % 16) * 4)) & 0xf;
+}
+
+static inline void set_codon(uint64_t *g, uint32_t p, uint64_t v) {
+	g[p / 16] &= ~(UINT64_C(0xf) << ((p % 16) * 4));
+	g[p / 16] |= v << ((p % 16) * 4);
+}
+
+static inline uint32_t next_codon(uint32_t p) {
+	return (p + 1 >= POND_DEPTH) ? EXEC_START_CODON : (p + 1);
+}
+
+// Random genomes, which mostly stop soon, or random genomes that start with a loop copying themselves into the
+// output buffer until they read a STOP, which is what cells in a pond that has evolved spend most codons on.
+static void make_batch(int loopy, uint64_t seed){
+	static const uint8_t copy_loop[] = { 0x0, 0x3, 0x9, 0x5, 0x8, 0x1, 0x3, 0xa, 0xb, 0xe };	// ZERO INC LOOP READG WRITEB FWD INC REP TURN SHARE
+	uint64_t i, j;
+
+	memset(initial, 0, sizeof(initial));
+	for(i=0; i<CELLS; i++){
+		for(j=0; j<POND_DEPTH_SYSWORDS; j++){
+			initial[i].genome[j] = splitmix64(&seed);
+			initial[i].out[j] = ~UINT64_C(0);
+		}
+		if (loopy) {
+			for(j=0; j<sizeof(copy_loop); j++){
+				set_codon(initial[i].genome, EXEC_START_CODON + j, copy_loop[j]);
+			}
+		}
+		initial[i].st.ip = EXEC_START_CODON;
+		initial[i].st.energy = CELL_ENERGY;
+	}
+}
+
+static int compare_batches(){
+	uint64_t i;
+
+	for(i=0; i<CELLS; i++){
+		struct vm_state *a = &scalar[i].st, *b = &lanes[i].st;
+		if (memcmp(scalar[i].genome, lanes[i].genome, sizeof(scalar[i].genome)) ||
+		    memcmp(scalar[i].out, lanes[i].out, sizeof(scalar[i].out)) ||
+		    (a->ip != b->ip) || (a->ptr != b->ptr) || (a->reg != b->reg) || (a->facing != b->facing) ||
+		    (a->energy != b->energy) || (a->lsp != b->lsp) || (a->fld != b->fld) || (a->stop != b->stop)) {
+			fprintf(stdout, "cell %lu differs: ip %u/%u ptr %u/%u reg %u/%u energy %u/%u lsp %u/%u fld %u/%u stop %u/%u\n",
+				i, a->ip, b->ip, a->ptr, b->ptr, a->reg, b->reg, a->energy, b->energy, a->lsp, b->lsp, a->fld, b->fld, a->stop, b->stop);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**************************************************************************************************************************/
+//
+// Scalar VM, as in nanopond's execCell() without neighbors or mutations. Runs a cell from wherever its state is
+// until it stops, and returns the codons it fetched.
+//
+/**************************************************************************************************************************/
+static uint64_t run_scalar(struct cell *c){
+	struct vm_state *s = &c->st;
+	uint64_t n = 0;
+	uint32_t inst, tmp;
+
+	while (s->energy && !s->stop) {
+		inst = codon_at(c->genome, s->ip);
+		--s->energy;
+		++n;
+		if (s->fld) {
+			if (inst == 0x9) {
+				++s->fld;
+			} else if (inst == 0xa) {
+				--s->fld;
+			}
+		} else {
+			switch(inst) {
+				case 0x0: s->reg = 0; s->ptr = 0; s->facing = 0; break;		// ZERO
+				case 0x1: s->ptr = (s->ptr + 1) % POND_DEPTH; break;		// FWD
+				case 0x2: s->ptr = (s->ptr + POND_DEPTH - 1) % POND_DEPTH; break;	// BACK
+				case 0x3: s->reg = (s->reg + 1) & 0xf; break;			// INC
+				case 0x4: s->reg = (s->reg - 1) & 0xf; break;			// DEC
+				case 0x5: s->reg = codon_at(c->genome, s->ptr); break;		// READG
+				case 0x6: set_codon(c->genome, s->ptr, s->reg); break;		// WRITEG
+				case 0x7: s->reg = codon_at(c->out, s->ptr); break;		// READB
+				case 0x8: set_codon(c->out, s->ptr, s->reg); break;		// WRITEB
+				case 0x9:							// LOOP
+					if (s->reg) {
+						if (s->lsp >= POND_DEPTH) {
+							s->stop = 1;
+						} else {
+							s->stack[s->lsp++] = s->ip;
+						}
+					} else {
+						s->fld = 1;
+					}
+					break;
+				case 0xa:							// REP
+					if (s->lsp) {
+						--s->lsp;
+						if (s->reg) {
+							s->ip = s->stack[s->lsp];
+							continue;
+						}
+					}
+					break;
+				case 0xb: s->facing = s->reg & 3; break;			// TURN
+				case 0xc:							// XCHG
+					s->ip = next_codon(s->ip);
+					tmp = s->reg;
+					s->reg = codon_at(c->genome, s->ip);
+					set_codon(c->genome, s->ip, tmp);
+					break;
+				case 0xd: break;						// KILL
+				case 0xe: break;						// SHARE
+				case 0xf: s->stop = 1; break;					// STOP
+			}
+		}
+		s->ip = next_codon(s->ip);
+	}
+	return n;
+}
+
+/**************************************************************************************************************************/
+//
+// Lane VM
+//
+/**************************************************************************************************************************/
+#define SET1(x) _mm256_set1_epi32(x)
+#define EQ(a, b) _mm256_cmpeq_epi32((a), (b))
+#define AND(a, b) _mm256_and_si256((a), (b))
+#define ANDNOT(a, b) _mm256_andnot_si256((a), (b))	// ~a & b
+#define OR(a, b) _mm256_or_si256((a), (b))
+#define BLEND(a, b, m) _mm256_blendv_epi8((a), (b), (m))	// m ? b : a
+#define MASKBITS(m) _mm256_movemask_ps(_mm256_castsi256_ps(m))
+#define STORE(p, v) _mm256_store_si256((__m256i *)(p), (v))
+#define LOAD(p) _mm256_load_si256((const __m256i *)(p))
+
+// Codons at positions pos of the genomes or buffers starting at 32-bit word base of the batch
+static inline __m256i gather_codons(const int32_t *mem, __m256i base, __m256i pos){
+	__m256i w = _mm256_i32gather_epi32(mem, _mm256_add_epi32(base, _mm256_srli_epi32(pos, 3)), 4);
+	return AND(_mm256_srlv_epi32(w, _mm256_slli_epi32(AND(pos, SET1(7)), 2)), SET1(0xf));
+}
+
+// Eight lanes and the cells they run. The vectors are copied out to the arrays below them when lanes are refilled.
+struct lane_group {
+	__m256i ip, ptr, reg, facing, energy, lsp, fld, stop, gbase, obase, scratch;
+	struct {
+		int32_t ip[LANES], ptr[LANES], reg[LANES], facing[LANES], energy[LANES], lsp[LANES], fld[LANES], stop[LANES];
+		int32_t gbase[LANES], obase[LANES], a[LANES], b[LANES];
+	} ls;
+	// Each lane has a spare slot on top of its stack, which takes the stores of lanes that are not pushing
+	int32_t stack[LANES * (LANE_STACK + 1)];
+	int64_t cell_of[LANES];
+} __attribute__ ((aligned (32)));
+
+#define CELL_WORDS ((int32_t)(sizeof(struct cell) / 4))
+#define GENOME_WORDS ((int32_t)(offsetof(struct cell, genome) / 4))
+#define OUT_WORDS ((int32_t)(offsetof(struct cell, out) / 4))
+
+// Runs one step of a group of lanes over a batch of n cells, first handing back cells that have finished and filling
+// their lanes with the next ones. Returns 0 once the group has nothing left to run.
+static inline int lane_step(struct lane_group *g, struct cell *c, uint64_t n, uint64_t *next, uint64_t *codons){
+	int32_t *const mem = (int32_t *)c;
+	const __m256i zero = _mm256_setzero_si256(), ones = SET1(-1);
+	const __m256i lane_stack = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), SET1(LANE_STACK + 1));
+	__m256i ip = g->ip, ptr = g->ptr, reg = g->reg, facing = g->facing, energy = g->energy, lsp = g->lsp;
+	__m256i fld = g->fld, stop = g->stop, gbase = g->gbase, obase = g->obase;
+	__m256i active = ANDNOT(OR(EQ(energy, zero), stop), ones);
+	uint64_t i;
+	int l, bits;
+
+	// Hand finished cells back and fill their lanes from the batch
+	bits = MASKBITS(active) ^ 0xff;
+	if (bits) {
+		STORE(g->ls.ip, ip); STORE(g->ls.ptr, ptr); STORE(g->ls.reg, reg); STORE(g->ls.facing, facing);
+		STORE(g->ls.energy, energy); STORE(g->ls.lsp, lsp); STORE(g->ls.fld, fld); STORE(g->ls.stop, stop);
+		STORE(g->ls.gbase, gbase); STORE(g->ls.obase, obase);
+		for(l=0; l<LANES; l++){
+			if (!((bits >> l) & 1)) {
+				continue;
+			}
+			if (g->cell_of[l] >= 0) {
+				struct vm_state *s = &c[g->cell_of[l]].st;
+				s->ip = g->ls.ip[l]; s->ptr = g->ls.ptr[l]; s->reg = g->ls.reg[l]; s->facing = g->ls.facing[l];
+				s->energy = g->ls.energy[l]; s->lsp = g->ls.lsp[l]; s->fld = g->ls.fld[l];
+				s->stop = (g->ls.stop[l] && !s->retired) ? 1 : 0;
+				for(i=0; i<s->lsp; i++){
+					s->stack[i] = g->stack[l * (LANE_STACK + 1) + i];
+				}
+				g->cell_of[l] = -1;
+			}
+			g->ls.energy[l] = g->ls.stop[l] = 0;
+			g->ls.gbase[l] = (int32_t)n * CELL_WORDS + GENOME_WORDS;
+			g->ls.obase[l] = (int32_t)n * CELL_WORDS + OUT_WORDS;
+			if (*next < n) {
+				struct vm_state *s = &c[*next].st;
+				g->cell_of[l] = *next;
+				g->ls.gbase[l] = (int32_t)*next * CELL_WORDS + GENOME_WORDS;
+				g->ls.obase[l] = (int32_t)*next * CELL_WORDS + OUT_WORDS;
+				g->ls.ip[l] = s->ip; g->ls.ptr[l] = s->ptr; g->ls.reg[l] = s->reg; g->ls.facing[l] = s->facing;
+				g->ls.energy[l] = s->energy; g->ls.lsp[l] = 0; g->ls.fld[l] = s->fld; g->ls.stop[l] = s->stop ? -1 : 0;
+				(*next)++;
+			}
+		}
+		ip = LOAD(g->ls.ip); ptr = LOAD(g->ls.ptr); reg = LOAD(g->ls.reg); facing = LOAD(g->ls.facing);
+		energy = LOAD(g->ls.energy); lsp = LOAD(g->ls.lsp); fld = LOAD(g->ls.fld); stop = LOAD(g->ls.stop);
+		gbase = LOAD(g->ls.gbase); obase = LOAD(g->ls.obase);
+		g->ip = ip; g->ptr = ptr; g->reg = reg; g->facing = facing; g->energy = energy; g->lsp = lsp;
+		g->fld = fld; g->stop = stop; g->gbase = gbase; g->obase = obase;
+		active = ANDNOT(OR(EQ(energy, zero), stop), ones);
+		if (!MASKBITS(active)) {
+			return *next < n;
+		}
+	}
+
+	// Fetch
+	__m256i inst = gather_codons(mem, gbase, ip);
+	__m256i skipping = ANDNOT(EQ(fld, zero), active);
+	__m256i exec = ANDNOT(skipping, active);
+	__m256i m9 = AND(exec, EQ(inst, SET1(0x9)));
+	__m256i reg_nz = ANDNOT(EQ(reg, zero), ones);
+
+	// KILL, SHARE and loops too deep for the lane go to the scalar path before the fetch is paid for. Stopping the
+	// lane hands the cell back on the next step, and retired tells it from one that ran STOP.
+	__m256i retire = AND(exec, OR(OR(EQ(inst, SET1(0xd)), EQ(inst, SET1(0xe))),
+		AND(AND(m9, reg_nz), EQ(lsp, SET1(LANE_STACK)))));
+	bits = MASKBITS(retire);
+	if (bits) {
+		for(l=0; l<LANES; l++){
+			if ((bits >> l) & 1) {
+				c[g->cell_of[l]].st.retired = 1;
+			}
+		}
+		stop = OR(stop, retire);
+		active = ANDNOT(retire, active);
+		exec = ANDNOT(retire, exec);
+		m9 = ANDNOT(retire, m9);
+	}
+	*codons += __builtin_popcount(MASKBITS(active));
+	energy = _mm256_add_epi32(energy, active);	// active is -1 in each running lane
+
+	// False LOOPs: count LOOPs and REPs until the matching one
+	fld = _mm256_sub_epi32(fld, AND(skipping, EQ(inst, SET1(0x9))));
+	fld = _mm256_add_epi32(fld, AND(skipping, EQ(inst, SET1(0xa))));
+
+	// Instruction masks
+	__m256i m0 = AND(exec, EQ(inst, zero));
+	__m256i m1 = AND(exec, EQ(inst, SET1(0x1)));
+	__m256i m2 = AND(exec, EQ(inst, SET1(0x2)));
+	__m256i m3 = AND(exec, EQ(inst, SET1(0x3)));
+	__m256i m4 = AND(exec, EQ(inst, SET1(0x4)));
+	__m256i m5 = AND(exec, EQ(inst, SET1(0x5)));
+	__m256i m6 = AND(exec, EQ(inst, SET1(0x6)));
+	__m256i m7 = AND(exec, EQ(inst, SET1(0x7)));
+	__m256i m8 = AND(exec, EQ(inst, SET1(0x8)));
+	__m256i m10 = AND(exec, EQ(inst, SET1(0xa)));
+	__m256i m11 = AND(exec, EQ(inst, SET1(0xb)));
+	__m256i m12 = AND(exec, EQ(inst, SET1(0xc)));
+	__m256i m15 = AND(exec, EQ(inst, SET1(0xf)));
+
+	// Next instruction, for all but a REP that jumps back
+	__m256i ip1 = _mm256_add_epi32(ip, SET1(1));
+	ip1 = BLEND(ip1, SET1(EXEC_START_CODON), EQ(ip1, SET1(POND_DEPTH)));
+
+	// WRITEG, WRITEB and XCHG: there is no scatter, so every lane stores a word, and lanes that are not writing
+	// store into a word of the scratch cell that no gather reads. Lanes never share a word, as each has its own cell.
+	__m256i writes = OR(OR(m6, m8), m12);
+	if (MASKBITS(writes)) {
+		__m256i pos = BLEND(ptr, ip1, m12);
+		__m256i addr = _mm256_add_epi32(BLEND(gbase, obase, m8), _mm256_srli_epi32(pos, 3));
+		__m256i shift = _mm256_slli_epi32(AND(pos, SET1(7)), 2);
+		__m256i w = _mm256_i32gather_epi32(mem, addr, 4);
+		__m256i old = AND(_mm256_srlv_epi32(w, shift), SET1(0xf));
+		__m256i nw = OR(ANDNOT(_mm256_sllv_epi32(SET1(0xf), shift), w), _mm256_sllv_epi32(reg, shift));
+		STORE(g->ls.a, BLEND(g->scratch, addr, writes));
+		STORE(g->ls.b, nw);
+		for(l=0; l<LANES; l++){
+			mem[g->ls.a[l]] = g->ls.b[l];
+		}
+		reg = BLEND(reg, old, m12);
+		reg_nz = ANDNOT(EQ(reg, zero), ones);
+	}
+
+	// READG and READB
+	__m256i reads = OR(m5, m7);
+	if (MASKBITS(reads)) {
+		reg = BLEND(reg, gather_codons(mem, BLEND(gbase, obase, m7), ptr), reads);
+	}
+
+	// LOOP: push the true ones (every lane stores into its top slot), start skipping on the false ones
+	__m256i push = AND(m9, reg_nz);
+	if (MASKBITS(push)) {
+		STORE(g->ls.a, _mm256_add_epi32(lane_stack, lsp));
+		STORE(g->ls.b, ip);
+		for(l=0; l<LANES; l++){
+			g->stack[g->ls.a[l]] = g->ls.b[l];
+		}
+		lsp = _mm256_sub_epi32(lsp, push);
+	}
+	fld = BLEND(fld, SET1(1), ANDNOT(reg_nz, m9));
+
+	// REP: pop, and jump back to the LOOP if the register is not zero
+	__m256i pop = ANDNOT(EQ(lsp, zero), m10);
+	lsp = _mm256_add_epi32(lsp, pop);
+	__m256i jump = AND(pop, reg_nz);
+	if (MASKBITS(jump)) {
+		ip1 = BLEND(ip1, _mm256_mask_i32gather_epi32(zero, g->stack, _mm256_add_epi32(lane_stack, lsp), jump, 4), jump);
+	}
+
+	// Register, pointer and facing
+	reg = AND(_mm256_add_epi32(_mm256_sub_epi32(reg, m3), m4), SET1(0xf));
+	ptr = AND(_mm256_add_epi32(_mm256_sub_epi32(ptr, m1), m2), SET1(POND_DEPTH - 1));
+	facing = BLEND(facing, AND(reg, SET1(3)), m11);
+	g->reg = ANDNOT(m0, reg);
+	g->ptr = ANDNOT(m0, ptr);
+	g->facing = ANDNOT(m0, facing);
+	g->stop = OR(stop, m15);
+	g->energy = energy;
+	g->lsp = lsp;
+	g->fld = fld;
+
+	// XCHG skips a codon
+	__m256i ip2 = _mm256_add_epi32(ip1, SET1(1));
+	ip2 = BLEND(ip2, SET1(EXEC_START_CODON), EQ(ip2, SET1(POND_DEPTH)));
+	ip1 = BLEND(ip1, ip2, m12);
+	g->ip = BLEND(ip, ip1, active);
+	return 1;
+}
+
+// Runs a batch of n cells, LANE_GROUPS times eight at a time, and returns the codons fetched. c[n] must exist: idle
+// lanes point at it, since every lane loads and stores something on each step.
+static uint64_t run_lanes(struct cell *c, uint64_t n){
+	static struct lane_group groups[LANE_GROUPS];
+	uint64_t next = 0, codons = 0, i;
+	int j, l, busy;
+
+	memset(groups, 0, sizeof(groups));
+	for(j=0; j<LANE_GROUPS; j++){
+		for(l=0; l<LANES; l++){
+			groups[j].cell_of[l] = -1;
+		}
+		groups[j].gbase = SET1((int32_t)n * CELL_WORDS + GENOME_WORDS);
+		groups[j].obase = SET1((int32_t)n * CELL_WORDS + OUT_WORDS);
+		groups[j].scratch = _mm256_add_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+			SET1((int32_t)n * CELL_WORDS + (int32_t)(offsetof(struct cell, st.stack) / 4) + j * LANES));
+	}
+
+	do {
+		busy = 0;
+		for(j=0; j<LANE_GROUPS; j++){
+			busy |= lane_step(&groups[j], c, n, &next, &codons);
+		}
+	} while (busy);
+
+	// Retired cells finish on the scalar path
+	for(i=0; i<n; i++){
+		if (c[i].st.retired) {
+			c[i].st.retired = 0;
+			codons += run_scalar(&c[i]);
+		}
+	}
+	return codons;
+}
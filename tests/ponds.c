@@ -0,0 +1,139 @@
+#include <sys/time.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "nanopond.h"
+
+/*
+ * Runs several ponds in one process through libnanopond and checks that they do not get in each other's way: a
+ * pond must end up exactly the same whether it runs alone in one go, in small steps taking turns with another pond
+ * on the same thread, or next to other ponds on threads of their own. The last case is also timed, as the number of
+ * clock ticks all ponds run per second.
+ *
+ * Build the library first ("make libnanopond.a" in the top directory, which must be built without a parallel mode),
+ * then "make ponds" here and run ./ponds.
+ */
+
+/**************************************************************************************************************************/
+// Useful #defines
+//
+/**************************************************************************************************************************/
+#define START_TIMER gettimeofday(&start, NULL)
+#define STOP_TIMER gettimeofday(&end, NULL)
+#define DELTA_TIMER ((end.tv_sec-start.tv_sec)+(end.tv_usec-start.tv_usec)/1000000.0)
+
+#define TICKS 10000000					// Clock ticks each pond runs
+#define SLICE 12345					// Ticks per step when two ponds take turns
+#define PONDS 4						// Ponds run on threads of their own
+#define SEED 13
+#define SNAPSHOT_CELLS 4096				// Cells copied out at a time by digest()
+
+/**************************************************************************************************************************/
+// Data types and global variables.
+//
+/**************************************************************************************************************************/
+static struct timeval start, end;
+
+/**************************************************************************************************************************/
+// Function declarations
+//
+/**************************************************************************************************************************/
+static        uint64_t digest(const struct Pond *pond);
+
+/**************************************************************************************************************************/
+// main
+//
+/**************************************************************************************************************************/
+int main(){
+	struct Pond *a, *b, *ponds[PONDS];
+	uint64_t alone, i;
+	uint64_t sums[PONDS];
+	int failed = 0;
+
+	// One pond alone, in one go
+	if (!(a = pondCreate(SEED))) {
+		fprintf(stdout, "out of memory\n");
+		return 1;
+	}
+	START_TIMER;
+	pondStep(a, TICKS);
+	STOP_TIMER;
+	alone = digest(a);
+	pondDestroy(a);
+	fprintf(stdout, "1 pond: %lu ticks in %lfs (%.0f ticks/s)\n", (uint64_t)TICKS, DELTA_TIMER, TICKS / DELTA_TIMER);
+
+	// The same pond taking turns with another one on the same thread
+	a = pondCreate(SEED);
+	b = pondCreate(SEED + 1);
+	if (!a || !b) {
+		fprintf(stdout, "out of memory\n");
+		return 1;
+	}
+	while (pondClock(a) < TICKS) {
+		pondStep(a, (TICKS - pondClock(a) < SLICE) ? (TICKS - pondClock(a)) : SLICE);
+		pondStep(b, SLICE);
+	}
+	if (digest(a) != alone) {
+		fprintf(stdout, "pond taking turns differs from the pond run alone\n");
+		failed = 1;
+	}
+	pondDestroy(a);
+	pondDestroy(b);
+
+	// Ponds on threads of their own
+	for(i=0; i<PONDS; i++){
+		if (!(ponds[i] = pondCreate(SEED + i))) {
+			fprintf(stdout, "out of memory\n");
+			return 1;
+		}
+	}
+	START_TIMER;
+#pragma omp parallel for num_threads(PONDS) schedule(static, 1)
+	for(i=0; i<PONDS; i++){
+		pondStep(ponds[i], TICKS);
+		sums[i] = digest(ponds[i]);
+	}
+	STOP_TIMER;
+	if (sums[0] != alone) {
+		fprintf(stdout, "pond run next to others differs from the pond run alone\n");
+		failed = 1;
+	}
+	for(i=0; i<PONDS; i++){
+		pondDestroy(ponds[i]);
+	}
+	fprintf(stdout, "%d ponds on threads of their own: %lu ticks in %lfs (%.0f ticks/s)\n",
+		PONDS, (uint64_t)PONDS * TICKS, DELTA_TIMER, PONDS * TICKS / DELTA_TIMER);
+
+	if (!failed) {
+		fprintf(stdout, "ponds match\n");
+	}
+	return failed;
+}
+
+/**************************************************************************************************************************/
+// Hashes all cells of a pond (FNV-1a over every field), copying them out SNAPSHOT_CELLS at a time.
+//
+/**************************************************************************************************************************/
+static uint64_t digest(const struct Pond *pond){
+	struct PondCell *cells = malloc(SNAPSHOT_CELLS * sizeof(struct PondCell));
+	uint64_t h = 1469598103934665603ULL;
+	uint64_t first, n, i, k;
+
+	if (!cells) {
+		return 0;
+	}
+	for(first=0; (n = pondSnapshot(pond, first, SNAPSHOT_CELLS, cells)); first+=n){
+		for(i=0; i<n; i++){
+			const uint64_t v[5] = { cells[i].ID, cells[i].parentID, cells[i].lineage, cells[i].generation, cells[i].energy };
+			for(k=0; k<5; k++){
+				h = (h ^ v[k]) * 1099511628211ULL;
+			}
+			for(k=0; k<POND_GENOME_WORDS; k++){
+				h = (h ^ cells[i].genome[k]) * 1099511628211ULL;
+			}
+		}
+	}
+	free(cells);
+	return h;
+}
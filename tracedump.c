@@ -0,0 +1,84 @@
+/* Prints the events of traced executions that npx wrote to a trace
+ * file (see VM_TRACE in nanopond-params.h), or that a program using
+ * the library got from pondTraceRead(), one line each.
+ *
+ * Usage: tracedump [file]    (reads standard input without a file) */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "nanopond.h"
+
+/* Instruction names, by instruction */
+static const char *const instNames[16] = {
+  "ZERO", "FWD", "BACK", "INC", "DEC", "READG", "WRITEG", "READB",
+  "WRITEB", "LOOP", "REP", "TURN", "XCHG", "KILL", "SHARE", "STOP"
+};
+
+/**
+ * Prints one event
+ *
+ * @param e Event to print
+ */
+static void printEvent(const struct PondTraceEvent *const e)
+{
+  switch(e->kind) {
+    case PONDTRACE_CONTEXT:
+      printf("context %u", (unsigned)e->inst);
+      if (e->value) {
+        printf(" (%"PRIu64" events lost)", e->value);
+      }
+      printf("\n");
+      break;
+    case PONDTRACE_START:
+      printf("start %u,%u ID %"PRIu64"%s reg %x facing %u\n", (unsigned)e->ip, (unsigned)e->ptr, e->value,
+        e->inst ? " (resumed)" : "", (unsigned)e->reg, (unsigned)e->facing);
+      break;
+    case PONDTRACE_INST:
+    case PONDTRACE_SKIP:
+      printf("  %4u %-6s %s ptr %4u reg %x facing %u energy %"PRIu64, (unsigned)e->ip, instNames[e->inst & 0xf],
+        (e->kind == PONDTRACE_SKIP) ? "skip" : "    ", (unsigned)e->ptr, (unsigned)e->reg, (unsigned)e->facing, e->value);
+      if ((e->inst & 0xf) != (e->inst >> 4)) {
+        printf(" (mutated from %s)", instNames[e->inst >> 4]);
+      }
+      printf("\n");
+      break;
+    case PONDTRACE_OFFSPRING:
+      printf("  offspring at %u,%u ID %"PRIu64"\n", (unsigned)e->ip, (unsigned)e->ptr, e->value);
+      break;
+    case PONDTRACE_END:
+      printf("end after %"PRIu64" instructions at %u reg %x facing %u%s\n", e->value, (unsigned)e->ip,
+        (unsigned)e->reg, (unsigned)e->facing, e->inst ? " (parked)" : "");
+      break;
+    default:
+      printf("unknown event %u\n", (unsigned)e->kind);
+      break;
+  }
+}
+
+/**
+ * Main method
+ *
+ * @param argc Number of args
+ * @param argv Argument array
+ */
+int main(int argc, char **argv)
+{
+  struct PondTraceEvent events[4096];
+  FILE *f = stdin;
+  size_t n, i;
+
+  if ((argc > 1)&&(!(f = fopen(argv[1], "rb")))) {
+    fprintf(stderr, "*** Unable to open %s ***\n", argv[1]);
+    return 1;
+  }
+  while ((n = fread(events, sizeof(struct PondTraceEvent), sizeof(events) / sizeof(events[0]), f))) {
+    for(i=0;i<n;++i) {
+      printEvent(&events[i]);
+    }
+  }
+  if (f != stdin) {
+    fclose(f);
+  }
+  return 0;
+}
@@ -2,6 +2,9 @@
 
 /* adapted from https://en.wikipedia.org/wiki/Xorshift */
 #include <stdint.h>
+#include <string.h>
+#include <cpuid.h>
+#include <immintrin.h>
 
 // xorshift*
 /* vebatim https://en.wikipedia.org/wiki/Xorshift */
@@ -15,20 +18,260 @@ uint64_t xorshift64star(uint64_t state) {
   }
   return x;
 }
-void init_xorgen(uint64_t sd);
-static inline uint32_t xor_genrand_uint32();
-static inline uint64_t xor_genrand_uint64();
-
-#define genrand_uint32 xor_genrand_uint32
-#define genrand_uint64 xor_genrand_uint64
+// splitmix64
+/* verbatim http://xoroshiro.di.unimi.it/splitmix64.c */
+static inline uint64_t splitmix64(uint64_t *state) {
+  uint64_t z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
 
-#include <immintrin.h>
-#ifdef __AVX2__
+/* A stream is XLANES xorshift128+ generators (lanes) run side by side,
+ * whose outputs are taken lane by lane, XNGEN steps at a time. Which
+ * kernel runs the steps is chosen at startup from what the machine
+ * supports (see xor_select()); every kernel gives the same numbers, so
+ * one binary runs anywhere and gets the same results everywhere. A
+ * binary built for AVX2 (with -march=native on such a machine, say)
+ * has nothing slower to fall back to and leaves out the slower
+ * kernels. A stream of eight lanes is a different stream from one of
+ * four, but the AVX-512 kernel makes a whole step of it at once. */
+#ifndef XLANES
+#define XLANES 4
+#endif
+#ifndef XNGEN
 #define XNGEN 2 // value of 2 here seems to allow rdata to stay in cache
-#include "xorshift_avx2.h"
-#else // __AVX2__
-#ifdef __SSE4_1__
-#define XNGEN 1 // AVX1 and lower are faster with 1 because of smaller state
+#endif
+
+// kernels in the build: AVX-512 for streams of eight lanes, and none
+// slower than one the compile flags already require (XOR_HAVE_SSE41
+// brings in the scalar kernel too)
+#if XLANES % 8 == 0
+#define XOR_HAVE_AVX512 1
+#endif
+#if !(defined(XOR_HAVE_AVX512) && defined(__AVX512F__))
+#define XOR_HAVE_AVX2 1
+#endif
+#if !defined(__AVX2__)
+#define XOR_HAVE_SSE41 1
+#endif
+
+// generator state is per thread so worker threads never share a stream
+static _Thread_local uint64_t xorstate[2][XLANES] __attribute__((aligned(8*XLANES)));
+
+struct rdata {
+  union {
+    uint32_t i32[XNGEN*XLANES*2];
+    uint64_t i64[XNGEN*XLANES];
+  } bits __attribute__((aligned(8*XLANES)));
+  uint16_t idx;
+};
+
+static _Thread_local struct rdata rd32, rd64;
+
+#ifdef XOR_HAVE_SSE41
+#include "xorshift_scalar.h"
 #include "xorshift_sse4.h"
-#endif // __SSE4__
-#endif // __AVX2__
+#endif
+#ifdef XOR_HAVE_AVX2
+#include "xorshift_avx2.h"
+#endif
+#ifdef XOR_HAVE_AVX512
+#include "xorshift_avx512.h"
+#endif
+#include "xorshift_aes.h"
+
+// what a kernel needs of the machine
+#define XOR_CPU_SSE41 1
+#define XOR_CPU_AVX2 2
+#define XOR_CPU_AES 4
+#define XOR_CPU_AVX512 8
+
+// kernels, as switched on in xor_fill()
+#define XOR_FILL_SCALAR 0
+#define XOR_FILL_SSE41 1
+#define XOR_FILL_AVX2 2
+#define XOR_FILL_AVX512 3
+
+struct xorgen_kernel {
+  const char *name;
+  unsigned needs;
+  unsigned fill;
+};
+
+// fastest first
+static const struct xorgen_kernel xor_kernels[] = {
+#ifdef XOR_HAVE_AVX512
+  { "avx512", XOR_CPU_AVX512, XOR_FILL_AVX512 },
+#endif
+#ifdef XOR_HAVE_AVX2
+  { "avx2", XOR_CPU_AVX2, XOR_FILL_AVX2 },
+#endif
+#ifdef XOR_HAVE_SSE41
+  { "sse4.1", XOR_CPU_SSE41, XOR_FILL_SSE41 },
+  { "scalar", 0, XOR_FILL_SCALAR },
+#endif
+};
+#define XOR_KERNELS (sizeof(xor_kernels) / sizeof(xor_kernels[0]))
+
+struct xorgen_seeder {
+  const char *name;
+  unsigned needs;
+  void (*seed)(uint64_t sd, uint64_t s[2*XLANES]);
+};
+
+static const struct xorgen_seeder xor_seeders[] = {
+  { "aesni", XOR_CPU_AES, xor_seed_aesni },
+  { "aes-table", 0, xor_seed_soft },
+};
+#define XOR_SEEDERS (sizeof(xor_seeders) / sizeof(xor_seeders[0]))
+
+// kernel (in xor_kernels) and seeder in use, shared by all threads
+static const struct xorgen_kernel *xor_kernel = &xor_kernels[XOR_KERNELS - 1];
+static const struct xorgen_seeder *xor_seeder = &xor_seeders[XOR_SEEDERS - 1];
+
+// features of the machine from CPUID, the vector ones only if the OS
+// saves the registers they use
+static unsigned xor_cpu_features() {
+  unsigned a, b, c, d, f = 0;
+
+  if (!__get_cpuid(1, &a, &b, &c, &d)) {
+    return 0;
+  }
+  if (c & bit_SSE4_1) { f |= XOR_CPU_SSE41; }
+  if (c & bit_AES) { f |= XOR_CPU_AES; }
+  if ((c & bit_OSXSAVE) && (c & bit_AVX)) {
+    __asm__ ("xgetbv" : "=a"(a), "=d"(d) : "c"(0));
+    // AVX-512 also needs the OS to save the mask and upper ZMM registers
+    const unsigned xcr0 = a;
+    if (((xcr0 & 6) == 6) && __get_cpuid_count(7, 0, &a, &b, &c, &d)) {
+      if (b & bit_AVX2) { f |= XOR_CPU_AVX2; }
+      if ((b & bit_AVX512F) && ((xcr0 & 0xe6) == 0xe6)) { f |= XOR_CPU_AVX512; }
+    }
+  }
+  return f;
+}
+
+// picks the fastest kernel and seeder the machine supports
+__attribute__((constructor))
+static void xor_select() {
+  const unsigned f = xor_cpu_features();
+  unsigned i;
+
+  for (i = 0; (i < XOR_KERNELS - 1) && ((xor_kernels[i].needs & f) != xor_kernels[i].needs); i++);
+  xor_kernel = &xor_kernels[i];
+  for (i = 0; (xor_seeders[i].needs & f) != xor_seeders[i].needs; i++);
+  xor_seeder = &xor_seeders[i];
+}
+
+// uses the kernel or seeder with this name instead, if the machine
+// supports it (for testing and benchmarking); returns 0 if not. Must
+// not be called while other threads draw numbers.
+int xorgen_select(const char *name) {
+  const unsigned f = xor_cpu_features();
+
+  for (unsigned i = 0; i < XOR_KERNELS; i++) {
+    if (!strcmp(name, xor_kernels[i].name) && ((xor_kernels[i].needs & f) == xor_kernels[i].needs)) {
+      xor_kernel = &xor_kernels[i];
+      return 1;
+    }
+  }
+  for (unsigned i = 0; i < XOR_SEEDERS; i++) {
+    if (!strcmp(name, xor_seeders[i].name) && ((xor_seeders[i].needs & f) == xor_seeders[i].needs)) {
+      xor_seeder = &xor_seeders[i];
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// names of the kernel and seeder in use
+const char *xorgen_kernel() {
+  return xor_kernel->name;
+}
+
+const char *xorgen_seeder() {
+  return xor_seeder->name;
+}
+
+void init_xorgen(uint64_t sd) {
+  uint64_t s[2*XLANES];
+
+  xor_seeder->seed(sd, s);
+  memcpy(xorstate, s, sizeof(xorstate));
+  rd32.idx = 0;
+  rd64.idx = 0;
+}
+
+// cheap reseed for many short independent streams; unlike init_xorgen()
+// this may be called for every stream
+void reseed_xorgen(uint64_t key) {
+  for (int i = 0; i < XLANES; i++) { xorstate[0][i] = splitmix64(&key); }
+  for (int i = 0; i < XLANES; i++) { xorstate[1][i] = splitmix64(&key); }
+  rd32.idx = 0;
+  rd64.idx = 0;
+}
+
+// whole state of the calling thread's generator, so that several
+// streams can take turns on one thread
+struct xorgen_state {
+  uint64_t xorstate[2][XLANES] __attribute__((aligned(32)));
+  struct rdata rd32, rd64;
+};
+
+void save_xorgen(struct xorgen_state *s) {
+  memcpy(s->xorstate, xorstate, sizeof(xorstate));
+  s->rd32 = rd32;
+  s->rd64 = rd64;
+}
+
+void load_xorgen(const struct xorgen_state *s) {
+  memcpy(xorstate, s->xorstate, sizeof(xorstate));
+  rd32 = s->rd32;
+  rd64 = s->rd64;
+}
+
+// refills a buffer with the kernel in use. This switches between
+// direct calls rather than calling through a pointer, so the compiler
+// knows which registers each kernel uses and code drawing numbers in a
+// loop need not save all of them around a refill (which costs the
+// interpreter loop about 15%). With only one kernel it is inlined.
+static inline void xor_fill(uint64_t *out) {
+#if defined(XOR_HAVE_AVX512) && defined(__AVX512F__)
+  xor_fill_avx512(out);
+#elif !defined(XOR_HAVE_AVX512) && defined(__AVX2__)
+  xor_fill_avx2(out);
+#else
+  switch (xor_kernel->fill) {
+#ifdef XOR_HAVE_AVX512
+    case XOR_FILL_AVX512: xor_fill_avx512(out); break;
+#endif
+#ifdef XOR_HAVE_SSE41
+    case XOR_FILL_AVX2: xor_fill_avx2(out); break;
+    case XOR_FILL_SSE41: xor_fill_sse4(out); break;
+    default: xor_fill_scalar(out); break;
+#else
+    default: xor_fill_avx2(out); break;
+#endif
+  }
+#endif
+}
+
+#define XOR_GENERATOR(rd, bufsize) \
+if (rd.idx == 0 || rd.idx >= XNGEN*bufsize) {\
+  rd.idx = 0;\
+  xor_fill(rd.bits.i64);\
+}\
+
+static inline uint32_t xor_genrand_uint32() {
+  XOR_GENERATOR(rd32, XLANES*2)
+  return rd32.bits.i32[rd32.idx++];
+}
+
+static inline uint64_t xor_genrand_uint64() {
+  XOR_GENERATOR(rd64, XLANES)
+  return rd64.bits.i64[rd64.idx++];
+}
+
+#define genrand_uint32 xor_genrand_uint32
+#define genrand_uint64 xor_genrand_uint64
@@ -0,0 +1,27 @@
+// AVX-512 kernel: each step runs eight lanes at once, for streams of
+// eight lanes (or a multiple)
+__attribute__((target("avx512f")))
+static void xor_fill_avx512(uint64_t *out) {
+  for (int h = 0; h < XLANES; h += 8) {
+    register __m512i x = _mm512_load_si512((const void *)&xorstate[0][h]);
+    register __m512i y = _mm512_load_si512((const void *)&xorstate[1][h]);
+    register __m512i z;
+
+    for (int j = 0; j < XNGEN; j++) {
+      // x ^= x << 23; // a
+      x = _mm512_xor_si512(x, _mm512_slli_epi64(x, 23));
+
+      // s[1] = x ^ y ^ (x >> 17) ^ (y >> 26); // b, c
+      // (0x96 is the three-way xor)
+      z = _mm512_ternarylogic_epi64(x, y, _mm512_srli_epi64(x, 17), 0x96);
+      z = _mm512_xor_si512(z, _mm512_srli_epi64(y, 26));
+
+      // return s[1] + y;
+      _mm512_store_si512((void *)&out[j*XLANES + h], _mm512_add_epi64(z, y));
+      x = y;
+      y = z;
+    }
+    _mm512_store_si512((void *)&xorstate[0][h], x);
+    _mm512_store_si512((void *)&xorstate[1][h], y);
+  }
+}
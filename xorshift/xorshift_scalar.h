@@ -0,0 +1,15 @@
+// portable kernel: the four lanes one after the other in plain C, for
+// machines without SSE4.1 (and for checking the vector kernels)
+static void xor_fill_scalar(uint64_t *out) {
+  for (int j = 0; j < XNGEN; j++) {
+    for (int l = 0; l < XLANES; l++) {
+      uint64_t x = xorstate[0][l];
+      const uint64_t y = xorstate[1][l];
+
+      xorstate[0][l] = y;
+      x ^= x << 23; // a
+      xorstate[1][l] = x ^ y ^ (x >> 17) ^ (y >> 26); // b, c
+      out[j*XLANES + l] = xorstate[1][l] + y;
+    }
+  }
+}